@@ -0,0 +1,566 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "parse.h"
+# include "variable.h"
+# include "rules.h"
+# include "command.h"
+# include "hash.h"
+# include "newstr.h"
+# include "filesys.h"
+# include "md5.h"
+# include "sigdb.h"
+# include "acache.h"
+
+# ifdef unix
+# include <unistd.h>
+# include <utime.h>
+# endif
+
+/*
+ * acache.c - reuse what earlier runs of the same actions produced
+ *
+ * If $(ACTIONCACHE) names a directory, the targets that each action
+ * updated and the output it printed are kept there, under a key that
+ * sums up the action: its command text, the names of its targets, the
+ * contents of everything the target depends on (and the headers those
+ * include), and the content of the program the command starts with.
+ * When an action with the same key comes up again -- on another
+ * branch, or after a clean -- its targets are copied back from the
+ * cache and its output shown, instead of running it.
+ *
+ * Only targets updated by a single command are cached: a target
+ * updated by several (say, linked and then chmod'ed) is left alone.
+ * So are "updated", "together" and "piecemeal" actions, and actions
+ * that take one of their targets as a source: those update what is
+ * there (say, an archive), so their targets depend on more than the
+ * key can say.
+ *
+ * Each entry is one file, named by its key:
+ *
+ *	# jam action cache 1
+ *	<#targets> <output length>
+ *	<mode> <size>		(one line for each target)
+ *	<the targets' contents, then the output>
+ *
+ * The cache is kept to $(ACTIONCACHESIZE) megabytes (1024 if unset)
+ * by removing the entries least recently used: using an entry renews
+ * its file's time.
+ *
+ * External routines:
+ *
+ *	acache_key() - sum up a target's command, if it can be cached
+ *	acache_get() - restore a command's targets, if in the cache
+ *	acache_put() - store the targets a command updated
+ *	acache_done() - trim the cache to size, if anything was added
+ *
+ * Internal routines:
+ *
+ *	acache_init() - set up the cache named by $(ACTIONCACHE)
+ *	acache_tool() - add the program a command starts with to a key
+ *	acache_copy() - copy bytes from one file to another
+ *	acache_file() - note a file found in the cache directory
+ *	acache_older() - compare entries, for qsort()
+ */
+
+# define ACACHE_VERSION "# jam action cache 1\n"
+# define ACACHE_SIZE 1024		/* megabytes, by default */
+
+typedef struct _tool TOOL;
+
+struct _tool {
+	char	*name;		/* as the command names it */
+	char	*path;		/* where it was found on $PATH, or "" */
+} ;
+
+typedef struct _entry ENTRY;
+
+struct _entry {
+	char	*name;
+	long	size;
+	time_t	time;
+} ;
+
+static char *acachedir = 0;
+static double acachemax = 0;
+static struct hash *acachetools = 0;
+static int acachedirty = 0;
+
+static ENTRY *entries = 0;	/* acache_file()'s findings */
+static int nentries = 0;
+static int maxentries = 0;
+
+static int acache_init();
+static void acache_tool();
+static int acache_copy();
+static void acache_file();
+static int acache_older();
+
+/*
+ * acache_init() - set up the cache named by $(ACTIONCACHE)
+ *
+ * Returns 0 if $(ACTIONCACHE) isn't set.
+ */
+
+static int
+acache_init()
+{
+	struct stat statbuf;
+	LIST	*l;
+
+	if( acachedir )
+	    return *acachedir != '\0';
+
+	if( !( l = var_get( "ACTIONCACHE" ) ) )
+	    return 0;
+
+	acachedir = l->string;
+
+	l = var_get( "ACTIONCACHESIZE" );
+	acachemax = ( l ? atoi( l->string ) : ACACHE_SIZE ) * 1048576.0;
+
+# ifdef unix
+	mkdir( acachedir, 0777 );
+# endif
+
+	if( stat( acachedir, &statbuf ) < 0 ||
+	    ( statbuf.st_mode & S_IFMT ) != S_IFDIR )
+	{
+	    printf( "warning: no action cache directory %s\n", acachedir );
+	    acachedir = "";
+	    return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * acache_key() - sum up a target's command, if it can be cached
+ *
+ * Sets cmd->key (which cmd_free() frees) and returns 1 if so.
+ */
+
+int
+acache_key( t, cmd )
+TARGET	*t;
+CMD	*cmd;
+{
+	char	hex[ 2 * MD5_SIZE + 1 ];
+	unsigned char digest[ MD5_SIZE ];
+	LIST	*l, *s;
+	MD5	m;
+	int	i;
+
+	if( !acache_init() || cmd->next || t->flags & T_FLAG_NOTFILE )
+	    return 0;
+
+	if( cmd->rule->flags & ( RULE_NEWSRCS | RULE_TOGETHER | RULE_PIECEMEAL ) )
+	    return 0;
+
+	for( l = lol_get( &cmd->args, 0 ); l; l = list_next( l ) )
+	    for( s = lol_get( &cmd->args, 1 ); s; s = list_next( s ) )
+		if( !strcmp( l->string, s->string ) )
+		    return 0;
+
+	md5_init( &m );
+	md5_update( &m, (unsigned char *)ACACHE_VERSION,
+		strlen( ACACHE_VERSION ) );
+	md5_update( &m, (unsigned char *)cmd->buf, cmd->len + 1 );
+
+	for( l = lol_get( &cmd->args, 0 ); l; l = list_next( l ) )
+	    md5_update( &m, (unsigned char *)l->string, strlen( l->string ) + 1 );
+
+	for( l = cmd->shell; l; l = list_next( l ) )
+	    md5_update( &m, (unsigned char *)l->string, strlen( l->string ) + 1 );
+
+	sigdb_inputs( t, hex );
+	md5_update( &m, (unsigned char *)hex, strlen( hex ) + 1 );
+
+	acache_tool( cmd->buf, &m );
+
+	md5_final( &m, digest );
+
+	cmd->key = malloc( sizeof( hex ) );
+
+	for( i = 0; i < MD5_SIZE; i++ )
+	    sprintf( cmd->key + 2 * i, "%02x", digest[i] );
+
+	return 1;
+}
+
+/*
+ * acache_tool() - add the program a command starts with to a key
+ *
+ * Looks for it along $PATH (once per name), and adds its content:
+ * a new compiler is a new action, even if its command isn't.
+ */
+
+static void
+acache_tool( buf, m )
+char	*buf;
+MD5	*m;
+{
+	char	path[ MAXJPATH ];
+	char	hex[ 2 * MD5_SIZE + 1 ];
+	char	*p, *e;
+	struct stat statbuf;
+	TOOL	tool, *tl = &tool;
+	int	n;
+
+	while( isspace( *buf ) )
+	    buf++;
+
+	for( n = 0; buf[n] && !isspace( buf[n] ); n++ )
+	    if( strchr( ";|&<>()", buf[n] ) )
+		break;
+
+	if( !n || n >= MAXJPATH )
+	    return;
+
+	memcpy( path, buf, n );
+	path[n] = '\0';
+
+	if( !acachetools )
+	    acachetools = hashinit( sizeof( TOOL ), "tools" );
+
+	tl->name = path;
+
+	if( hashenter( acachetools, (HASHDATA **)&tl ) )
+	{
+	    tl->name = newstr( path );
+	    tl->path = strchr( path, '/' ) ? tl->name : "";
+
+	    for( p = getenv( "PATH" ); !*tl->path && p && *p; p = e )
+	    {
+		if( !( e = strchr( p, SPLITPATH ) ) )
+		    e = p + strlen( p );
+
+		if( e - p + n + 2 <= MAXJPATH )
+		{
+		    sprintf( path, "%.*s/%s", (int)( e - p ), p, tl->name );
+
+		    if( !stat( path, &statbuf ) &&
+			( statbuf.st_mode & S_IFMT ) == S_IFREG )
+			    tl->path = newstr( path );
+		}
+
+		if( *e )
+		    e++;
+	    }
+	}
+
+	md5_update( m, (unsigned char *)tl->name, strlen( tl->name ) + 1 );
+
+	if( *tl->path && sigdb_file( tl->path, hex ) )
+	    md5_update( m, (unsigned char *)hex, strlen( hex ) + 1 );
+}
+
+/*
+ * acache_get() - restore a command's targets, if in the cache
+ *
+ * Returns 1 if they were, with *output set to the command's output
+ * (malloc'ed, for the caller to free).
+ */
+
+int
+acache_get( cmd, output )
+CMD	*cmd;
+char	**output;
+{
+	char	path[ MAXJPATH ], tmp[ MAXJPATH + 5 ];	/* target.new */
+	char	buf[ 128 ];
+	LIST	*l;
+	FILE	*f, *g;
+	int	ntargets, mode;
+	long	outlen, size;
+	long	sizes[ 64 ];
+	int	modes[ 64 ];
+	int	i;
+
+	if( !cmd->key || strlen( acachedir ) + 34 > MAXJPATH )
+	    return 0;
+
+	sprintf( path, "%s/%s", acachedir, cmd->key );
+
+	if( !( f = fopen( path, "rb" ) ) )
+	    return 0;
+
+	if( !fgets( buf, sizeof( buf ), f ) || strcmp( buf, ACACHE_VERSION ) ||
+	    !fgets( buf, sizeof( buf ), f ) ||
+	    sscanf( buf, "%d %ld", &ntargets, &outlen ) != 2 ||
+	    ntargets > 64 )
+	{
+	    fclose( f );
+	    return 0;
+	}
+
+	for( i = 0; i < ntargets; i++ )
+	{
+	    if( !fgets( buf, sizeof( buf ), f ) ||
+		sscanf( buf, "%d %ld", &mode, &size ) != 2 )
+	    {
+		fclose( f );
+		return 0;
+	    }
+
+	    modes[i] = mode;
+	    sizes[i] = size;
+	}
+
+	/* Copy each target to a new file, and rename it into place. */
+
+	for( i = 0, l = lol_get( &cmd->args, 0 ); i < ntargets && l;
+		i++, l = list_next( l ) )
+	{
+	    if( strlen( l->string ) + 5 > MAXJPATH )
+		break;
+
+	    sprintf( tmp, "%s.new", l->string );
+
+	    if( !( g = fopen( tmp, "wb" ) ) )
+		break;
+
+	    if( !acache_copy( f, g, sizes[i] ) )
+	    {
+		fclose( g );
+		unlink( tmp );
+		break;
+	    }
+
+	    if( fclose( g ) )
+	    {
+		unlink( tmp );
+		break;
+	    }
+
+# ifdef unix
+	    chmod( tmp, modes[i] );
+# endif
+
+	    if( rename( tmp, l->string ) )
+	    {
+		unlink( tmp );
+		break;
+	    }
+	}
+
+	if( i < ntargets || l )
+	{
+	    fclose( f );
+	    return 0;
+	}
+
+	*output = malloc( outlen + 1 );
+	outlen = fread( *output, 1, outlen, f );
+	(*output)[ outlen ] = '\0';
+
+	fclose( f );
+
+	/* Keep it from being evicted for a while. */
+
+# ifdef unix
+	utime( path, (struct utimbuf *)0 );
+# endif
+
+	if( DEBUG_MAKEPROG )
+	    printf( "...using %s from the action cache...\n", path );
+
+	return 1;
+}
+
+/*
+ * acache_put() - store the targets a command updated
+ */
+
+void
+acache_put( cmd, output )
+CMD	*cmd;
+char	*output;
+{
+	char	path[ MAXJPATH ], tmp[ MAXJPATH + 5 ];	/* path.new */
+	struct stat statbuf;
+	LIST	*l;
+	FILE	*f, *g;
+	int	ntargets = 0;
+	int	ok = 1;
+
+	if( !cmd->key || strlen( acachedir ) + 38 > MAXJPATH )
+	    return;
+
+	if( !output )
+	    output = "";
+
+	for( l = lol_get( &cmd->args, 0 ); l; l = list_next( l ) )
+	    ntargets++;
+
+	if( ntargets > 64 )
+	    return;
+
+	sprintf( path, "%s/%s", acachedir, cmd->key );
+	sprintf( tmp, "%s.new", path );
+
+	if( !( f = fopen( tmp, "wb" ) ) )
+	    return;
+
+	fputs( ACACHE_VERSION, f );
+	fprintf( f, "%d %ld\n", ntargets, (long)strlen( output ) );
+
+	for( l = lol_get( &cmd->args, 0 ); ok && l; l = list_next( l ) )
+	{
+	    if( stat( l->string, &statbuf ) < 0 )
+		ok = 0;
+	    else
+		fprintf( f, "%d %ld\n",
+		    (int)( statbuf.st_mode & 07777 ), (long)statbuf.st_size );
+	}
+
+	for( l = lol_get( &cmd->args, 0 ); ok && l; l = list_next( l ) )
+	{
+	    if( !( g = fopen( l->string, "rb" ) ) )
+	    {
+		ok = 0;
+		break;
+	    }
+
+	    if( fstat( fileno( g ), &statbuf ) < 0 ||
+		!acache_copy( g, f, (long)statbuf.st_size ) )
+		    ok = 0;
+
+	    fclose( g );
+	}
+
+	if( ok )
+	    fputs( output, f );
+
+	if( fclose( f ) || !ok || rename( tmp, path ) )
+	{
+	    unlink( tmp );
+	    return;
+	}
+
+	acachedirty = 1;
+}
+
+/*
+ * acache_copy() - copy bytes from one file to another
+ *
+ * Returns 0 unless all size bytes were copied.
+ */
+
+static int
+acache_copy( from, to, size )
+FILE	*from;
+FILE	*to;
+long	size;
+{
+	char	buf[ 8192 ];
+	int	n;
+
+	while( size > 0 )
+	{
+	    n = size < sizeof( buf ) ? size : sizeof( buf );
+
+	    if( fread( buf, 1, n, from ) != n || fwrite( buf, 1, n, to ) != n )
+		return 0;
+
+	    size -= n;
+	}
+
+	return 1;
+}
+
+/*
+ * acache_done() - trim the cache to size, if anything was added
+ */
+
+void
+acache_done()
+{
+	double	total = 0;
+	int	i;
+
+	if( !acachedirty )
+	    return;
+
+	file_dirscan( acachedir, acache_file );
+
+	for( i = 0; i < nentries; i++ )
+	    total += entries[i].size;
+
+	if( total > acachemax )
+	{
+	    qsort( (char *)entries, nentries, sizeof( ENTRY ), acache_older );
+
+	    for( i = 0; i < nentries && total > acachemax; i++ )
+	    {
+		if( DEBUG_MAKEPROG )
+		    printf( "...removing %s from the action cache...\n",
+			entries[i].name );
+
+		if( !unlink( entries[i].name ) )
+		    total -= entries[i].size;
+	    }
+	}
+
+	for( i = 0; i < nentries; i++ )
+	    free( entries[i].name );
+
+	free( (char *)entries );
+	entries = 0;
+	nentries = maxentries = 0;
+	acachedirty = 0;
+}
+
+/*
+ * acache_file() - note a file found in the cache directory
+ *
+ * Only names as long as a key (entries, and any left half-written)
+ * are taken.
+ */
+
+static void
+acache_file( name, found, time )
+char	*name;
+int	found;
+time_t	time;
+{
+	struct stat statbuf;
+	char	*base = strrchr( name, '/' );
+
+	base = base ? base + 1 : name;
+
+	if( strlen( base ) < 2 * MD5_SIZE ||
+	    stat( name, &statbuf ) < 0 ||
+	    ( statbuf.st_mode & S_IFMT ) != S_IFREG )
+		return;
+
+	if( nentries == maxentries )
+	{
+	    maxentries = maxentries ? maxentries * 2 : 256;
+	    entries = (ENTRY *)realloc( (char *)entries,
+			maxentries * sizeof( ENTRY ) );
+	}
+
+	entries[ nentries ].name = malloc( strlen( name ) + 1 );
+	strcpy( entries[ nentries ].name, name );
+	entries[ nentries ].size = statbuf.st_size;
+	entries[ nentries ].time = statbuf.st_mtime;
+	nentries++;
+}
+
+/*
+ * acache_older() - compare entries, for qsort()
+ */
+
+static int
+acache_older( a, b )
+ENTRY	*a;
+ENTRY	*b;
+{
+	return a->time < b->time ? -1 : a->time > b->time;
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * acache.h - reuse what earlier runs of the same actions produced
+ */
+
+int acache_key();
+int acache_get();
+void acache_put();
+void acache_done();
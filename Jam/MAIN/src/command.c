@@ -36,32 +36,29 @@
  */
 
 CMD *
-cmd_new( chain, rule, targets, sources, shell )
+cmd_new( chain, rule, targets, sources, shell, flags )
 CMD	*chain;
 RULE	*rule;
 LIST	*targets;
 LIST	*sources;
 LIST	*shell;
+int	flags;
 {
-	int     len;
-
 	CMD *cmd = (CMD *)malloc( sizeof( CMD ) );
 
 	cmd->rule = rule;
 	cmd->shell = shell;
+	cmd->flags = flags;
+	cmd->pool = 0;
+	cmd->key = 0;
 
 	lol_init( &cmd->args );
 	lol_add( &cmd->args, targets );
 	lol_add( &cmd->args, sources );
 
-	len = var_string( rule->actions, cmd->buf, CMDBUF, &cmd->args );
-	
-	if( len < 0 )
-	{
-	    printf( "fatal error: %s command block too long (max %d)\n", 
-		rule->name, CMDBUF );
-	    exit( EXITBAD );
-	}
+	/* The command text is built exactly to size: no CMDBUF limit. */
+
+	cmd->buf = var_string( rule->actions, &cmd->args, &cmd->len );
 
 	if( !chain ) chain = cmd;
 	else chain->tail->next = cmd;
@@ -81,5 +78,7 @@ CMD	*cmd;
 {
 	lol_free( &cmd->args );
 	list_free( cmd->shell );
+	free( cmd->buf );
+	free( cmd->key );
 	free( (char *)cmd );
 }
@@ -29,8 +29,12 @@ struct _cmd
 	CMD	*tail;		/* valid on in head */
 	RULE	*rule;		/* rule->actions contains shell script */
 	LIST	*shell;		/* $(SHELL) value */
+	int	flags;		/* EXEC_xxx flags for execcmd() */
+	char	*pool;		/* $(JOBPOOL) value, or 0 */
+	char	*key;		/* action cache key (malloc'ed), or 0 */
 	LOL	args;		/* LISTs for $(<), $(>) */
-	char	buf[ CMDBUF ];	/* actual commands */
+	char	*buf;		/* actual commands, malloc'ed to size */
+	int	len;		/* strlen( buf ) */
 } ;
 
 CMD 	*cmd_new();
@@ -14,6 +14,11 @@
 # include "newstr.h"
 # include "make.h"
 # include "search.h"
+# include "hash.h"
+
+# ifdef unix
+# include <sys/time.h>
+# endif
 
 /*
  * compile.c - compile parsed jam statements
@@ -32,11 +37,17 @@
  *	compile_setexec() - support for `actions` - save execution string 
  *	compile_settings() - compile the "on =" (set variable on exec) statement
  *	compile_switch() - compile 'switch' rule
+ *	compile_profile() - show the time spent in each rule, with -d+10
  *
  * Internal routines:
  *
  *	debug_compile() - printf with indent to show rule expansion.
  *
+ *	profile_enter() - note a rule starting, for -d+10
+ *	profile_exit() - note a rule finishing, for -d+10
+ *	profile_clock() - the time, in seconds, for the profile
+ *	profile_compare() - qsort() rules by net time, most first
+ *
  *	evaluate_if() - evaluate if to determine which leg to compile
  *
  *	builtin_depends() - DEPENDS/INCLUDES rule
@@ -60,6 +71,11 @@
 
 static void debug_compile();
 
+static void profile_enter();
+static void profile_exit();
+static double profile_clock();
+static int profile_compare();
+
 static int evaluate_if();
 
 static void builtin_depends();
@@ -69,6 +85,37 @@ static void builtin_flags();
 
 int glob();
 
+/*
+ * The rule profile: with -d+10, compile_rule() counts the calls to
+ * each rule (builtins included) and the time spent in it, gross and
+ * net of the rules it calls.  A recursive rule's gross time counts 
+ * only its outermost call.
+ */
+
+typedef struct _profile PROFILE;
+
+struct _profile {
+	char	*name;
+	int	calls;
+	int	active;		/* calls on the stack */
+	double	gross;
+	double	net;
+	PROFILE	*next;		/* for compile_profile() */
+} ;
+
+typedef struct _profile_frame PROFILE_FRAME;
+
+struct _profile_frame {
+	PROFILE	*profile;
+	double	start;
+	double	subtime;	/* in rules this one called */
+	PROFILE_FRAME *caller;
+} ;
+
+static struct hash *profiles = 0;
+static PROFILE *profilelist = 0;
+static PROFILE_FRAME *profiletop = 0;
+
 
 
 /*
@@ -404,6 +451,10 @@ LOL		*args;
 	RULE	*rule = bindrule( parse->string );
 	LOL	nargs[1];
 	PARSE	*p;
+	PROFILE_FRAME frame;
+
+	if( DEBUG_PROFILE )
+	    profile_enter( rule->name, &frame );
 
 	/* Build up the list of arg lists */
 
@@ -460,6 +511,9 @@ LOL		*args;
 
 	if( DEBUG_COMPILE )
 	    debug_compile( -1, 0 );
+
+	if( DEBUG_PROFILE )
+	    profile_exit( &frame );
 }
 
 /*
@@ -785,3 +839,125 @@ char *s;
 
 	level += which;
 }
+
+/*
+ * profile_compare() - qsort() rules by net time, most first
+ */
+
+static int
+profile_compare( a, b )
+const void *a;
+const void *b;
+{
+	double d = (*(PROFILE **)b)->net - (*(PROFILE **)a)->net;
+
+	return d > 0 ? 1 : d < 0 ? -1 : 0;
+}
+
+/*
+ * compile_profile() - show the time spent in each rule, with -d+10
+ */
+
+void
+compile_profile()
+{
+	PROFILE	*p, **v;
+	int	i, n = 0;
+
+	if( !DEBUG_PROFILE || !profilelist )
+	    return;
+
+	for( p = profilelist; p; p = p->next )
+	    n++;
+
+	v = (PROFILE **)malloc( n * sizeof( PROFILE * ) );
+
+	for( i = 0, p = profilelist; p; p = p->next )
+	    v[ i++ ] = p;
+
+	qsort( (char *)v, n, sizeof( PROFILE * ), profile_compare );
+
+	printf( "%10s %10s %10s %10s  %s\n", 
+		"gross", "net", "calls", "net/call", "rule" );
+
+	for( i = 0; i < n; i++ )
+	    printf( "%10.3f %10.3f %10d %10.6f  %s\n",
+		v[i]->gross, v[i]->net, v[i]->calls, 
+		v[i]->net / v[i]->calls, v[i]->name );
+
+	free( (char *)v );
+}
+
+/*
+ * profile_enter() - note a rule starting, for -d+10
+ */
+
+static void
+profile_enter( name, frame )
+char		*name;
+PROFILE_FRAME	*frame;
+{
+	PROFILE	prof, *p = &prof;
+
+	if( !profiles )
+	    profiles = hashinit( sizeof( PROFILE ), "profile" );
+
+	p->name = name;
+
+	if( hashenter( profiles, (HASHDATA **)&p ) )
+	{
+	    p->name = newstr( name );
+	    p->calls = p->active = 0;
+	    p->gross = p->net = 0;
+	    p->next = profilelist;
+	    profilelist = p;
+	}
+
+	p->calls++;
+	p->active++;
+
+	frame->profile = p;
+	frame->subtime = 0;
+	frame->caller = profiletop;
+	profiletop = frame;
+
+	frame->start = profile_clock();
+}
+
+/*
+ * profile_exit() - note a rule finishing, for -d+10
+ */
+
+static void
+profile_exit( frame )
+PROFILE_FRAME	*frame;
+{
+	PROFILE	*p = frame->profile;
+	double	elapsed = profile_clock() - frame->start;
+
+	p->net += elapsed - frame->subtime;
+
+	if( !--p->active )
+	    p->gross += elapsed;
+
+	if( profiletop = frame->caller )
+	    profiletop->subtime += elapsed;
+}
+
+/*
+ * profile_clock() - the time, in seconds, for the profile
+ */
+
+static double
+profile_clock()
+{
+# ifdef unix
+	struct timeval tv;
+
+	gettimeofday( &tv, (struct timezone *)0 );
+
+	return tv.tv_sec + tv.tv_usec / 1e6;
+# else
+	return (double)clock() / CLOCKS_PER_SEC;
+# endif
+}
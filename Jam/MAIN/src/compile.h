@@ -24,6 +24,7 @@ void compile_setcomp();
 void compile_setexec();
 void compile_settings();
 void compile_switch();
+void compile_profile();
 
 /* Flags for compile_set(), etc */
 
@@ -0,0 +1,310 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "variable.h"
+# include "hash.h"
+# include "newstr.h"
+# include "dcache.h"
+
+/*
+ * dcache.c - remember what directory scans found, across runs
+ *
+ * If $(DIRCACHEFILE) names a file, it holds the names of the files
+ * found in each directory timestamp() scanned, along with the
+ * directory's modification time.  While that still matches, the
+ * directory isn't read again: its files are entered from the cache.
+ *
+ * Only the names are kept, not the files' own timestamps: changing
+ * a file in place doesn't change its directory's time, so those must
+ * still be taken afresh (by file_time()) each run.
+ *
+ * The file starts with a version line, and then has one entry per
+ * scanned directory:
+ *
+ *	<time> <age> <#files> <directory name>
+ *	<file name>		(one line for each)
+ *
+ * <age> counts the runs since the entry was last used, as in the
+ * header cache (see hcache.c).
+ *
+ * External routines:
+ *
+ *	dcache_init() - read the cache file named by $(DIRCACHEFILE)
+ *	dcache_get() - get the files found in a directory, if still valid
+ *	dcache_put() - remember the files found in a directory
+ *	dcache_done() - write the cache file back, if anything changed
+ *
+ * Internal routines:
+ *
+ *	dcache_read() - read one line of the cache file
+ */
+
+# define DCACHE_VERSION "# jam directory cache 1\n"
+# define DCACHE_MAXAGE 100
+
+typedef struct _dcache DCACHE;
+
+struct _dcache {
+	char	*name;		/* directory, as timestamp() scanned it */
+	time_t	time;
+	int	age;		/* runs since last used */
+	LIST	*files;		/* what it held */
+	DCACHE	*next;		/* for dcache_done() */
+} ;
+
+static struct hash *dcachehash = 0;
+static DCACHE *dcachelist = 0;
+static char *dcachefile = 0;
+static int dcachedirty = 0;
+
+static int dcache_read();
+
+/*
+ * dcache_init() - read the cache file named by $(DIRCACHEFILE)
+ *
+ * Returns 0 if $(DIRCACHEFILE) isn't set (yet: it may be set after
+ * the first Jamfiles are bound).
+ */
+
+int
+dcache_init()
+{
+	LIST	*l;
+	FILE	*f;
+	char	buf[ MAXJPATH + 64 ];
+	DCACHE	dcache, *c;
+	int	nfiles, age, n;
+	long	time;
+
+	if( dcachefile )
+	    return 1;
+
+	if( !( l = var_get( "DIRCACHEFILE" ) ) )
+	    return 0;
+
+	dcachefile = l->string;
+	dcachehash = hashinit( sizeof( DCACHE ), "dcache" );
+
+	if( !( f = fopen( dcachefile, "r" ) ) )
+	    return 1;
+
+	if( !dcache_read( buf, sizeof( buf ), f ) ||
+	    strcmp( buf, DCACHE_VERSION ) )
+	{
+	    printf( "warning: ignoring directory cache %s\n", dcachefile );
+	    fclose( f );
+	    return 1;
+	}
+
+	while( dcache_read( buf, sizeof( buf ), f ) )
+	{
+	    c = &dcache;
+
+	    if( sscanf( buf, "%ld %d %d %n", &time, &age, &nfiles, &n ) < 3 )
+		break;
+
+	    buf[ strlen( buf ) - 1 ] = '\0';
+	    c->name = buf + n;
+
+	    if( hashenter( dcachehash, (HASHDATA **)&c ) )
+	    {
+		c->name = newstr( c->name );
+		c->next = dcachelist;
+		dcachelist = c;
+	    }
+	    else
+	    {
+		list_free( c->files );
+	    }
+
+	    c->time = time;
+	    c->age = age;
+	    c->files = 0;
+
+	    for( ; nfiles; nfiles-- )
+	    {
+		if( !dcache_read( buf, sizeof( buf ), f ) )
+		    break;
+
+		buf[ strlen( buf ) - 1 ] = '\0';
+		c->files = list_new( c->files, newstr( buf ) );
+	    }
+
+	    /* A short entry can't be trusted: nor can the rest. */
+
+	    if( nfiles )
+	    {
+		c->time = 0;
+		break;
+	    }
+	}
+
+	fclose( f );
+
+	if( DEBUG_BINDSCAN )
+	    printf( "read directory cache from %s\n", dcachefile );
+
+	return 1;
+}
+
+/*
+ * dcache_read() - read one line of the cache file
+ *
+ * Returns 0 at EOF, or if the line is too long to be one jam wrote.
+ */
+
+static int
+dcache_read( buf, len, f )
+char	*buf;
+int	len;
+FILE	*f;
+{
+	return fgets( buf, len, f ) && strchr( buf, '\n' );
+}
+
+/*
+ * dcache_get() - get the files found in a directory, if still valid
+ *
+ * Returns the cached LIST of the directory's files (not a copy) if
+ * its time is the one it was last scanned at; else 0.
+ */
+
+LIST *
+dcache_get( dir, time )
+char	*dir;
+time_t	time;
+{
+	DCACHE	dcache, *c = &dcache;
+
+	if( !dcache_init() || !time )
+	    return 0;
+
+	c->name = dir;
+
+	if( !hashcheck( dcachehash, (HASHDATA **)&c ) || c->time != time )
+	    return 0;
+
+	if( c->age > 1 )
+	    dcachedirty = 1;
+
+	c->age = 0;
+
+	return c->files;
+}
+
+/*
+ * dcache_put() - remember the files found in a directory
+ *
+ * Takes over the LIST of files.  A directory changed within the last
+ * second might yet change again with the same time: it isn't kept.
+ */
+
+void
+dcache_put( dir, mtime, files )
+char	*dir;
+time_t	mtime;
+LIST	*files;
+{
+	DCACHE	dcache, *c = &dcache;
+	LIST	*l;
+
+	if( !dcache_init() || !mtime || mtime >= time( (time_t *)0 ) - 1 )
+	{
+	    list_free( files );
+	    return;
+	}
+
+	/* Names with newlines can't be written back. */
+
+	for( l = files; l; l = list_next( l ) )
+	{
+	    if( strchr( l->string, '\n' ) )
+	    {
+		list_free( files );
+		return;
+	    }
+	}
+
+	c->name = dir;
+
+	if( hashenter( dcachehash, (HASHDATA **)&c ) )
+	{
+	    c->name = newstr( dir );
+	    c->next = dcachelist;
+	    dcachelist = c;
+	}
+	else
+	{
+	    list_free( c->files );
+	}
+
+	c->time = mtime;
+	c->age = 0;
+	c->files = files;
+
+	dcachedirty = 1;
+}
+
+/*
+ * dcache_done() - write the cache file back, if anything changed
+ */
+
+void
+dcache_done()
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	DCACHE	*c;
+	LIST	*l;
+	int	nfiles;
+
+	/* Entries not used this run have aged, even if none was; */
+	/* those used again go back to age 1. */
+
+	dcache_init();
+
+	for( c = dcachelist; c; c = c->next )
+	    if( c->age )
+		dcachedirty = 1;
+
+	if( !dcachefile || !dcachedirty )
+	    return;
+
+	if( strlen( dcachefile ) + 5 > MAXJPATH )
+	    return;
+
+	sprintf( tmp, "%s.new", dcachefile );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "can't write directory cache %s\n", tmp );
+	    return;
+	}
+
+	fputs( DCACHE_VERSION, f );
+
+	for( c = dcachelist; c; c = c->next )
+	{
+	    if( !c->time || c->age >= DCACHE_MAXAGE )
+		continue;
+
+	    for( nfiles = 0, l = c->files; l; l = list_next( l ) )
+		nfiles++;
+
+	    fprintf( f, "%ld %d %d %s\n",
+		(long)c->time, c->age + 1, nfiles, c->name );
+
+	    for( l = c->files; l; l = list_next( l ) )
+		fprintf( f, "%s\n", l->string );
+	}
+
+	if( fclose( f ) || rename( tmp, dcachefile ) )
+	    printf( "can't write directory cache %s\n", dcachefile );
+
+	dcachedirty = 0;
+}
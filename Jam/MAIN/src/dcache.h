@@ -0,0 +1,14 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * dcache.h - remember what directory scans found, across runs
+ */
+
+int dcache_init();
+LIST *dcache_get();
+void dcache_put();
+void dcache_done();
@@ -7,12 +7,42 @@
 /*
  * execcmd.h - execute a shell script
  *
+ * execcmd( string, func, closure, shell, flags ) calls
+ * (*func)( closure, status, output, info ) when the command completes.
+ * Output is the command's stdout and stderr if EXEC_CAPTURE was
+ * given and the platform can collect it, or 0.  Info says how the
+ * command ran, as far as the platform can tell, or is 0.
+ *
+ * execwait() waits for a command to complete; execcheck() only
+ * drives the completions of commands that have already finished.
+ *
  * 05/04/94 (seiwald) - async multiprocess interface
  */
 
 void execcmd();
 int execwait();
+int execcheck();
+void execinit();
 
 # define EXEC_CMD_OK	0
 # define EXEC_CMD_FAIL	1
 # define EXEC_CMD_INTR	2
+
+/* Flags for execcmd() */
+
+# define EXEC_SHELL	0x01	/* always run via the shell */
+# define EXEC_CAPTURE	0x02	/* collect output for func */
+
+/* EXECINFO - how a command ran, for (*func) */
+
+typedef struct _execinfo EXECINFO;
+
+struct _execinfo {
+	int	slot;		/* job slot, from 1 */
+	int	exitcode;	/* its exit status, as $? has it, or -1 */
+	double	start;		/* when it started, in seconds */
+	double	end;		/* when it completed */
+	double	user;		/* its user CPU seconds, or -1 if unknown */
+	double	sys;		/* its system CPU seconds, or -1 */
+	long	maxrss;		/* its peak resident KB, or -1 */
+} ;
@@ -31,6 +31,8 @@
  * External routines:
  *	execcmd() - launch an async command execution
  * 	execwait() - wait and drive at most one execution completion
+ *	execinit() - get ready to run commands (nothing to do)
+ *	execcheck() - drive finished commands' completions (nothing to do)
  *
  * Internal routines:
  *	onintr() - bump intr to note command interruption
@@ -45,15 +47,16 @@
  */
 
 void
-execcmd( string, func, closure, shell )
+execcmd( string, func, closure, shell, flags )
 char *string;
 void (*func)();
 void *closure;
 LIST *shell;
+int flags;
 {
 	
 	printf( "%s", string );
-	(*func)( closure, EXEC_CMD_OK );
+	(*func)( closure, EXEC_CMD_OK, (char *)0, (EXECINFO *)0 );
 }
 
 /*
@@ -66,4 +69,23 @@ execwait()
 	return 0;
 }
 
+/*
+ * execinit() - get ready to run commands (nothing to do)
+ */
+
+void
+execinit()
+{
+}
+
+/*
+ * execcheck() - drive finished commands' completions (nothing to do)
+ */
+
+int
+execcheck()
+{
+	return 0;
+}
+
 # endif /* macintosh */
@@ -31,86 +31,1151 @@
 static int my_wait(int *status);
 # endif
 
+# else
+
+# include <unistd.h>
+# include <sys/wait.h>
+# include <sys/time.h>
+# include <sys/resource.h>
+# include <poll.h>
+
+# define EXEC_POLL
+
+# ifdef _POSIX_SPAWN
+# include <spawn.h>
+# define EXEC_DIRECT
+extern char **environ;
+# endif
+
+# endif
+
+/*
+ * execunix.c - execute a shell script on UNIX/WinNT/OS2
+ *
+ * If $(JAMSHELL) is defined, uses that to formulate execvp()/spawnvp().
+ * The default is:
+ *
+ *	/bin/sh -c %		[ on UNIX ]
+ *	cmd.exe /c %		[ on OS2/WinNT ]
+ *
+ * Each word must be an individual element in a jam variable value.
+ *
+ * In $(JAMSHELL), % expands to the command string and ! expands to 
+ * the slot number (starting at 1) for multiprocess (-j) invocations.
+ * If $(JAMSHELL) doesn't include a %, it is tacked on as the last
+ * argument.
+ *
+ * Don't just set JAMSHELL to /bin/sh or cmd.exe - it won't work!
+ *
+ * The running commands table has globs.jobs slots, handed out from a
+ * stack of free slots, and a hash maps child pids back to their slots.
+ *
+ * On UNIX, if $(JAMSHELL) isn't set, a command that is a single line
+ * of plain words (no quoting, redirection, globbing, variables, or
+ * shell builtins) doesn't need /bin/sh at all: it is split at blanks
+ * and posix_spawnp()'ed directly.
+ *
+ * Other commands (again, if $(JAMSHELL) isn't set) are handed to a 
+ * long-lived /bin/sh kept for each job slot, so that the cost of 
+ * starting the shell is paid once per slot rather than once per 
+ * action.  The worker reads framed commands on its stdin:
+ *
+ *	( eval '<command>' ) <&4 3>&- 4>&-; echo $? >&3
+ *
+ * Fd 3 is a pipe back to jam that carries the exit status, and fd 4 
+ * is jam's own stdin.  The subshell keeps one action's cd's and 
+ * variables from leaking into the next.  A worker that dies is 
+ * restarted the next time its slot is used.
+ *
+ * Execcmd()'s EXEC_SHELL flag, set from $(NOSHELLBYPASS), disables
+ * both: each command gets a fresh /bin/sh -c.
+ *
+ * On UNIX, execwait() is an event loop: it poll()s a SIGCHLD self-pipe,
+ * the workers' status pipes, and, for commands launched with the
+ * EXEC_CAPTURE flag, a pipe carrying the command's stdout and stderr.
+ * The captured output is handed to the completion function, which can
+ * print it in one piece.
+ *
+ * With -j, jam also runs a GNU make compatible jobserver: a pipe holding
+ * one token per job slot beyond the first, advertised to children with
+ * MAKEFLAGS=" -jN --jobserver-auth=R,W".  If jam itself is run under a
+ * jobserver (found in MAKEFLAGS, as R,W or fifo:PATH), it joins that
+ * one instead.  Either way, each command beyond the first that jam runs
+ * at once takes a token, and gives it back when it completes, so that
+ * sub-makes and sub-jams share the -j budget.  Jam reads tokens through
+ * its own non-blocking open of the pipe (/proc/self/fd/R), so as not to
+ * change the pipe's mode under the other processes using it.
+ *
+ * With -l or -m, execcmd() first waits for running commands to finish
+ * while the machine is too busy (by /proc/loadavg or /proc/meminfo, on
+ * Linux) to take another one, unless none of ours are running.
+ *
+ * External routines:
+ *	execcmd() - launch an async command execution
+ * 	execwait() - wait and drive at most one execution completion
+ *	execcheck() - drive the completions of commands already finished
+ *	execinit() - size the job tables and set up the jobserver
+ *
+ * Internal routines:
+ *	onintr() - bump intr to note command interruption
+ *	pidenter() - map a child's pid to its slot
+ *	pidfind() - find the slot for a child's pid
+ *	piddelete() - forget a child's pid
+ *	execsplit() - split a simple command into an argv[], if possible
+ *	workerstart() - start the shell worker for a slot
+ *	workerstop() - shut down and reap a slot's shell worker
+ *	workerexec() - send a command to a slot's shell worker
+ *	onchild() - note SIGCHLD on the self-pipe for execpoll()
+ *	execpipe() - make a pipe whose fds won't leak into children
+ *	execread() - read what's waiting in a slot's output pipe
+ *	execpoll() - wait for a command to finish, collecting output
+ *	execdone() - drive a command's completion
+ *	execclock() - the time, in seconds, for EXECINFO
+ *	execbusy() - check the -l/-m limits before starting another command
+ *	jsinit() - join the jobserver in MAKEFLAGS, or start one for -j
+ *	jsopen() - open a jobserver pipe for non-blocking reads
+ *	jstake() - take a jobserver token, if one is waiting
+ *	jsgive() - give back tokens no longer needed
+ *
+ * 04/08/94 (seiwald) - Coherent/386 support added.
+ * 05/04/94 (seiwald) - async multiprocess interface
+ * 01/22/95 (seiwald) - $(JAMSHELL) support
+ * 06/02/97 (gsar)    - full async multiprocess support for Win32
+ */
+
+static int intr = 0;
+
+/* A wait() status, as the shell's $? would give it. */
+
+# define EXITCODE( s ) \
+	( ( (s) & 0x7f ) ? 128 + ( (s) & 0x7f ) : ( (s) >> 8 ) & 0xff )
+
+static int cmdsrunning = 0;
+
+# ifdef NT
+static void (*istat)( int );
+void onintr( int );
+# else
+static void (*istat)();
+#endif
+
+static struct cmdtab
+{
+	int	pid;		/* on win32, a real process handle */
+	void	(*func)();
+	void 	*closure;
+	double	start;		/* execclock() at launch */
+# if defined( NT ) || defined( __OS2__ )
+	char	*tempfile;
+# endif
+# ifdef EXEC_POLL
+	int	haveru;		/* ru is valid: reaped with wait4() */
+	struct rusage ru;
+	int	worker;		/* running in workers[ slot ] */
+	int	outfd;		/* captured output, or -1 */
+	char	*out;		/* captured output so far */
+	int	outlen;
+	int	outsize;
+# endif
+} *cmdtab = 0;
+
+static int cmdmax;		/* slots in cmdtab[] */
+static int *cmdfree;		/* stack of free slots */
+static int ncmdfree;
+
+static struct pident
+{
+	int	pid;		/* 0 if empty */
+	int	slot;
+	int	worker;		/* pid is workers[ slot ]'s shell */
+} *pidtab;
+
+static int pidmask;		/* pidtab[] size - 1 */
+
+# ifdef EXEC_POLL
+
+static struct worker
+{
+	int	pid;		/* shell's pid, or 0 once reaped */
+	int	open;		/* cmdfd/statfd/outfd are valid */
+	int	cmdfd;		/* commands to shell's stdin */
+	int	statfd;		/* exit status from shell's fd 3 */
+	int	outfd;		/* shell's stdout/stderr, or -1 */
+} *workers;
+
+static int sigpipe[2];		/* SIGCHLD self-pipe */
+
+static struct pollfd *pollv;	/* for execpoll() */
+static int *pollslot;
+
+static void onchild();
+static int execpipe();
+static int workerexec();
+static void workerstop();
+static int execread();
+static int execpoll();
+static void execdone();
+static double execclock();
+static int execbusy();
+static void jsinit();
+static int jsopen();
+static int jstake();
+static void jsgive();
+
+static int jsread = -1;		/* jobserver tokens, non-blocking */
+static int jswrite = -1;	/* jobserver, for giving tokens back */
+static char *jstokens;		/* tokens held, one per extra command */
+static int njstokens;
+static int jswant;		/* execpoll() returns when a token waits */
+
+# endif
+
+/*
+ * onintr() - bump intr to note command interruption
+ */
+
+void
+onintr( disp )
+int disp;
+{
+	intr++;
+	printf( "...interrupted\n" );
+}
+
+/*
+ * execinit() - size the job tables and set up the jobserver
+ */
+
+void
+execinit()
+{
+	int i;
+
+	if( cmdtab )
+	    return;
+
+# ifdef EXEC_POLL
+	jsinit();
+# endif
+
+	cmdmax = globs.jobs > 0 ? globs.jobs : 1;
+	cmdtab = (struct cmdtab *)calloc( cmdmax, sizeof( *cmdtab ) );
+	cmdfree = (int *)malloc( cmdmax * sizeof( int ) );
+
+	/* Lowest slot on top, so ! numbers stay small */
+
+	for( i = 0; i < cmdmax; i++ )
+	    cmdfree[ i ] = cmdmax - 1 - i;
+
+	ncmdfree = cmdmax;
+
+	/* Each slot can have a command's and a worker's pid. */
+	/* Keep the hash at most a quarter full. */
+
+	for( pidmask = 15; pidmask < 4 * cmdmax; pidmask = pidmask * 2 + 1 )
+	    ;
+
+	pidtab = (struct pident *)calloc( pidmask + 1, sizeof( *pidtab ) );
+
+# ifdef EXEC_POLL
+	workers = (struct worker *)calloc( cmdmax, sizeof( *workers ) );
+
+	for( i = 0; i < cmdmax; i++ )
+	    cmdtab[ i ].outfd = -1;
+
+	/* Each slot can have an output and a status pipe, */
+	/* and there's the jobserver. */
+
+	pollv = (struct pollfd *)malloc( ( 2 + 2 * cmdmax ) * sizeof( *pollv ) );
+	pollslot = (int *)malloc( ( 2 + 2 * cmdmax ) * sizeof( int ) );
+
+	/* SIGCHLD pokes the self-pipe, so execpoll() can poll() */
+	/* for exits, output and worker statuses alike. */
+
+	if( execpipe( sigpipe ) < 0 )
+	{
+	    perror( "pipe" );
+	    exit( EXITBAD );
+	}
+
+	fcntl( sigpipe[1], F_SETFL, O_NONBLOCK );
+	signal( SIGCHLD, onchild );
+
+	jstokens = malloc( cmdmax );
+# endif
+}
+
+/*
+ * pidenter() - map a child's pid to its slot
+ */
+
+static void
+pidenter( pid, slot, worker )
+int	pid;
+int	slot;
+int	worker;
+{
+	int i = pid & pidmask;
+
+	while( pidtab[ i ].pid && pidtab[ i ].pid != pid )
+	    i = ( i + 1 ) & pidmask;
+
+	pidtab[ i ].pid = pid;
+	pidtab[ i ].slot = slot;
+	pidtab[ i ].worker = worker;
+}
+
+/*
+ * pidfind() - find the slot for a child's pid
+ */
+
+static struct pident *
+pidfind( pid )
+int	pid;
+{
+	int i = pid & pidmask;
+
+	for( ; pidtab[ i ].pid; i = ( i + 1 ) & pidmask )
+	    if( pidtab[ i ].pid == pid )
+		return &pidtab[ i ];
+
+	return 0;
+}
+
+/*
+ * piddelete() - forget a child's pid
+ *
+ * Later entries in the probe run are moved up into the hole,
+ * unless they hash between the hole and where they sit.
+ */
+
+static void
+piddelete( pid )
+int	pid;
+{
+	struct pident *p = pidfind( pid );
+	int i, j, k;
+
+	if( !p )
+	    return;
+
+	i = p - pidtab;
+
+	for(;;)
+	{
+	    pidtab[ i ].pid = 0;
+
+	    for( j = i;; )
+	    {
+		j = ( j + 1 ) & pidmask;
+
+		if( !pidtab[ j ].pid )
+		    return;
+
+		k = pidtab[ j ].pid & pidmask;
+
+		if( i <= j ? ( i < k && k <= j ) : ( i < k || k <= j ) )
+		    continue;
+
+		break;
+	    }
+
+	    pidtab[ i ] = pidtab[ j ];
+	    i = j;
+	}
+}
+
+# ifdef EXEC_DIRECT
+
+/*
+ * execsplit() - split a simple command into an argv[], if possible
+ *
+ * Returns a malloc'ed argv[] (with the words themselves stored after
+ * the pointers) if string is a single line of words that /bin/sh would
+ * hand to the program unaltered.  Returns 0 if the shell is needed.
+ */
+
+static char *execbuiltins[] = {
+	"!", ".", ":", "[", "alias", "bg", "break", "case", "cd", 
+	"command", "continue", "do", "done", "elif", "else", "esac", 
+	"eval", "exec", "exit", "export", "fc", "fg", "fi", "for", 
+	"getopts", "hash", "if", "in", "jobs", "local", "read", 
+	"readonly", "return", "set", "shift", "source", "then", "times", 
+	"trap", "type", "ulimit", "umask", "unalias", "unset", "until", 
+	"wait", "while", 0
+} ;
+
+static char **
+execsplit( string )
+char	*string;
+{
+	char	*s, *e, *p;
+	char	**argv, **ap;
+	int	words = 0;
+	int	first = 1;
+
+	/* Discount leading/trailing white space */
+
+	for( s = string; *s && isspace( *s ); s++ )
+		;
+
+	for( e = s + strlen( s ); e > s && isspace( e[-1] ); e-- )
+		;
+
+	if( s == e )
+	    return 0;
+
+	/* Anything the shell would interpret sends us to the shell. */
+	/* That includes # and ~ at the start of a word, and = in the */
+	/* first word (a variable assignment). */
+
+	for( p = s; p < e; p++ )
+	{
+	    if( *p == ' ' || *p == '\t' )
+	    {
+		if( p > s && p[-1] != ' ' && p[-1] != '\t' )
+		    first = 0;
+		continue;
+	    }
+
+	    if( strchr( "\n\r|&;<>()$`\\\"'*?[]{}", *p ) )
+		return 0;
+
+	    if( ( p == s || p[-1] == ' ' || p[-1] == '\t' ) &&
+		( *p == '#' || *p == '~' ) )
+		    return 0;
+
+	    if( first && *p == '=' )
+		return 0;
+
+	    if( p == s || p[-1] == ' ' || p[-1] == '\t' )
+		words++;
+	}
+
+	/* Lay out argv[] and a copy of the words in one block */
+
+	argv = (char **)malloc( ( words + 1 ) * sizeof( char * ) + e - s + 1 );
+	p = (char *)( argv + words + 1 );
+	memcpy( p, s, e - s );
+	p[ e - s ] = '\0';
+
+	for( ap = argv; *p; )
+	{
+	    while( *p == ' ' || *p == '\t' )
+		*p++ = '\0';
+
+	    *ap++ = p;
+
+	    while( *p && *p != ' ' && *p != '\t' )
+		p++;
+	}
+
+	*ap = 0;
+
+	/* Builtins and reserved words need the shell, too. */
+
+	for( ap = execbuiltins; *ap; ap++ )
+	    if( !strcmp( argv[0], *ap ) )
+	{
+	    free( (char *)argv );
+	    return 0;
+	}
+
+	return argv;
+}
+
+# endif /* EXEC_DIRECT */
+
+# ifdef EXEC_POLL
+
+/*
+ * onchild() - note SIGCHLD on the self-pipe for execpoll()
+ */
+
+static void
+onchild( disp )
+int disp;
+{
+	int e = errno;
+
+	write( sigpipe[1], "", 1 );
+	errno = e;
+}
+
+/*
+ * execpipe() - make a pipe whose fds won't leak into children
+ *
+ * The read end is non-blocking, for execread().
+ */
+
+static int
+execpipe( fds )
+int	fds[2];
+{
+	if( pipe( fds ) < 0 )
+	    return -1;
+
+	fcntl( fds[0], F_SETFD, FD_CLOEXEC );
+	fcntl( fds[1], F_SETFD, FD_CLOEXEC );
+	fcntl( fds[0], F_SETFL, O_NONBLOCK );
+
+	return 0;
+}
+
+/*
+ * workerstart() - start the shell worker for a slot
+ */
+
+static int
+workerstart( w, capture )
+struct worker *w;
+int	capture;
+{
+	int cmdp[2], statp[2], outp[2];
+	int pid;
+
+	if( execpipe( cmdp ) < 0 )
+	    return -1;
+
+	if( execpipe( statp ) < 0 )
+	{
+	    close( cmdp[0] );
+	    close( cmdp[1] );
+	    return -1;
+	}
+
+	outp[0] = outp[1] = -1;
+
+	if( capture && execpipe( outp ) < 0 )
+	{
+	    close( cmdp[0] );
+	    close( cmdp[1] );
+	    close( statp[0] );
+	    close( statp[1] );
+	    return -1;
+	}
+
+	/* The worker's stdin must block, even if ours doesn't */
+
+	fcntl( cmdp[0], F_SETFL, 0 );
+
+	if( ( pid = fork() ) == 0 )
+	{
+	    /* Move things up out of the way before settling */
+	    /* them onto fds 0, 3 and 4 (and 1 and 2 if capturing). */
+
+	    int in = fcntl( 0, F_DUPFD, 10 );
+	    int cmd = fcntl( cmdp[0], F_DUPFD, 10 );
+	    int st = fcntl( statp[1], F_DUPFD, 10 );
+
+	    if( in < 0 )
+		in = open( "/dev/null", O_RDONLY );
+
+	    if( outp[1] >= 0 )
+	    {
+		dup2( outp[1], 1 );
+		dup2( outp[1], 2 );
+	    }
+
+	    dup2( cmd, 0 );
+	    dup2( st, 3 );
+	    dup2( in, 4 );
+	    close( cmd );
+	    close( st );
+	    close( in );
+
+	    execl( "/bin/sh", "/bin/sh", (char *)0 );
+	    _exit( 127 );
+	}
+
+	close( cmdp[0] );
+	close( statp[1] );
+
+	if( outp[1] >= 0 )
+	    close( outp[1] );
+
+	if( pid == -1 )
+	{
+	    close( cmdp[1] );
+	    close( statp[0] );
+	    if( outp[0] >= 0 )
+		close( outp[0] );
+	    return -1;
+	}
+
+	w->pid = pid;
+	w->open = 1;
+	w->cmdfd = cmdp[1];
+	w->statfd = statp[0];
+	w->outfd = outp[0];
+	pidenter( pid, w - workers, 1 );
+
+	return 0;
+}
+
+/*
+ * workerstop() - shut down and reap a slot's shell worker
+ */
+
+static void
+workerstop( w )
+struct worker *w;
+{
+	int status;
+
+	close( w->cmdfd );
+	close( w->statfd );
+
+	if( w->outfd >= 0 )
+	    close( w->outfd );
+
+	w->open = 0;
+
+	/* Closing its stdin makes the shell exit, if it hasn't */
+	/* already.  execpoll() may have reaped it already. */
+
+	if( w->pid )
+	{
+	    while( waitpid( w->pid, &status, 0 ) == -1 && errno == EINTR )
+		;
+	    piddelete( w->pid );
+	}
+
+	w->pid = 0;
+}
+
+/*
+ * workerexec() - send a command to a slot's shell worker
+ *
+ * Returns 0 if the worker has the command, -1 if the caller
+ * should run it some other way.
+ */
+
+static int
+workerexec( w, string, capture )
+struct worker *w;
+char	*string;
+int	capture;
+{
+	static char pre[] = "( eval '";
+	static char post[] = "' ) <&4 3>&- 4>&-; echo $? >&3\n";
+	void	(*pstat)();
+	char	*buf, *p, *s;
+	int	len, n;
+
+	/* A worker either captures output or it doesn't */
+
+	if( w->open && capture != ( w->outfd >= 0 ) )
+	    workerstop( w );
+
+	if( !w->open && workerstart( w, capture ) < 0 )
+	    return -1;
+
+	/* Single quote the command: ' becomes '\'' */
+
+	for( len = 0, s = string; *s; s++ )
+	    len += *s == '\'' ? 4 : 1;
+
+	buf = p = malloc( sizeof( pre ) + len + sizeof( post ) );
+
+	strcpy( p, pre );
+	p += sizeof( pre ) - 1;
+
+	for( s = string; *s; s++ )
+	    if( *s == '\'' )
+	{
+	    memcpy( p, "'\\''", 4 );
+	    p += 4;
+	}
+	else
+	{
+	    *p++ = *s;
+	}
+
+	strcpy( p, post );
+	p += sizeof( post ) - 1;
+
+	/* A dead worker mustn't take us down with SIGPIPE */
+
+	pstat = signal( SIGPIPE, SIG_IGN );
+
+	for( s = buf; s < p; s += n )
+	    if( ( n = write( w->cmdfd, s, p - s ) ) < 0 && errno != EINTR )
+		break;
+	    else if( n < 0 )
+		n = 0;
+
+	signal( SIGPIPE, pstat );
+	free( buf );
+
+	if( s < p )
+	{
+	    workerstop( w );
+	    return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * execread() - read what's waiting in a slot's output pipe
+ *
+ * Returns 0 at EOF (or error), 1 if the pipe is just empty for now.
+ */
+
+static int
+execread( c )
+struct cmdtab *c;
+{
+	int n;
+
+	for(;;)
+	{
+	    if( c->outsize - c->outlen < 1024 )
+	    {
+		c->outsize = c->outsize ? c->outsize * 2 : 4096;
+		c->out = realloc( c->out, c->outsize );
+	    }
+
+	    n = read( c->outfd, c->out + c->outlen, c->outsize - c->outlen - 1 );
+
+	    if( n > 0 )
+		c->outlen += n;
+	    else if( n < 0 && errno == EINTR )
+		continue;
+	    else
+		return n < 0 && errno == EAGAIN;
+	}
+}
+
+/*
+ * execpoll() - wait for a command to finish, collecting output
+ *
+ * Polls the SIGCHLD self-pipe, the output pipes of capturing
+ * commands, and the status pipes of workers running commands.
+ * Returns the cmdtab[] slot that completed, with its wait()-style
+ * status, or -1 if a jobserver token is waiting to be taken.
+ * Timeout is for poll(): if it's 0 and nothing has happened, returns
+ * -2 without waiting.
+ */
+
+static int
+execpoll( status, timeout )
+int	*status;
+int	timeout;
+{
+	char	buf[ 32 ];
+	int	i, j, n, w, npoll, worker;
+	struct pident *p;
+	struct cmdtab *c;
+	struct rusage ru;
+
+	for(;;)
+	{
+	    /* Reap any exited children.  Workers that died are */
+	    /* simply noted: their status pipes will report EOF. */
+
+	    while( ( w = wait4( -1, status, WNOHANG, &ru ) ) > 0 )
+	    {
+		if( !( p = pidfind( w ) ) )
+		{
+		    printf( "waif child found!\n" );
+		    exit( EXITBAD );
+		}
+
+		/* Piddelete() may move another entry into *p. */
+
+		i = p->slot;
+		worker = p->worker;
+		piddelete( w );
+
+		if( worker )
+		{
+		    workers[ i ].pid = 0;
+		    continue;
+		}
+
+		/* The command is gone, so what it wrote is in */
+		/* the pipe.  Don't wait on its stray children. */
+
+		c = &cmdtab[ i ];
+		c->ru = ru;
+		c->haveru = 1;
+		*status = EXITCODE( *status );
+
+		if( c->outfd >= 0 )
+		{
+		    execread( c );
+		    close( c->outfd );
+		    c->outfd = -1;
+		}
+
+		return i;
+	    }
+
+	    /* Wait for SIGCHLD, output, or some worker's status */
+	    /* (or a jobserver token, if execcmd() wants one). */
+
+	    pollv[0].fd = sigpipe[0];
+	    pollv[0].events = POLLIN;
+	    npoll = 1;
+
+	    if( jswant )
+	    {
+		pollv[ npoll ].fd = jsread;
+		pollv[ npoll ].events = POLLIN;
+		pollslot[ npoll++ ] = -1;
+	    }
+
+	    for( i = 0; i < cmdmax; i++ )
+	    {
+		if( !cmdtab[ i ].pid )
+		    continue;
+
+		if( cmdtab[ i ].outfd >= 0 )
+		{
+		    pollv[ npoll ].fd = cmdtab[ i ].outfd;
+		    pollv[ npoll ].events = POLLIN;
+		    pollslot[ npoll++ ] = i;
+		}
+
+		if( cmdtab[ i ].worker )
+		{
+		    pollv[ npoll ].fd = workers[ i ].statfd;
+		    pollv[ npoll ].events = POLLIN;
+		    pollslot[ npoll++ ] = i;
+		}
+	    }
+
+	    if( ( n = poll( pollv, npoll, timeout ) ) < 0 )
+	    {
+		if( errno == EINTR )
+		    continue;
+		perror( "poll" );
+		exit( EXITBAD );
+	    }
+
+	    if( !n )
+		return -2;
+
+	    if( pollv[0].revents )
+		while( read( sigpipe[0], buf, sizeof( buf ) ) > 0 )
+		    ;
+
+	    for( j = 1; j < npoll; j++ )
+	    {
+		if( !pollv[ j ].revents )
+		    continue;
+
+		if( pollslot[ j ] < 0 )
+		    return -1;
+
+		c = &cmdtab[ i = pollslot[ j ] ];
+
+		/* Output: a command's own pipe closes at EOF. */
+		/* A worker's pipe is only drained. */
+
+		if( pollv[ j ].fd == c->outfd )
+		{
+		    if( !execread( c ) && !c->worker )
+		    {
+			close( c->outfd );
+			c->outfd = -1;
+		    }
+		    continue;
+		}
+
+		/* Status is "N\n", written all at once. */
+		/* EOF means the worker died mid-command. */
+
+		for( w = 0; w < sizeof( buf ) - 1; w += n )
+		    if( ( n = read( workers[ i ].statfd, buf + w, 
+				sizeof( buf ) - 1 - w ) ) < 0 && errno == EINTR )
+			n = 0;
+		    else if( n <= 0 || memchr( buf + w, '\n', n ) )
+			break;
+
+		if( c->outfd >= 0 )
+		    execread( c );
+
+		if( n <= 0 )
+		{
+		    workerstop( &workers[ i ] );
+		    *status = -1;
+		}
+		else
+		{
+		    buf[ w + n ] = '\0';
+		    *status = atoi( buf );
+		}
+
+		return i;
+	    }
+	}
+}
+
+/*
+ * execbusy() - check the -l/-m limits before starting another command
+ *
+ * The figures are sampled at most once a second.  Because the load 
+ * average lags, commands started since the last sample count toward
+ * the load, too.
+ */
+
+static int execstarted;		/* commands started since sampling */
+
+static int
+execbusy()
+{
+	static double load = 0.0;	/* 1 minute load average */
+	static int avail = -1;		/* MemAvailable, in MB */
+	static struct timeval last;
+	struct timeval now;
+
+	if( globs.load <= 0.0 && globs.memfree <= 0 )
+	    return 0;
+
+	gettimeofday( &now, 0 );
+
+	if( now.tv_sec != last.tv_sec || avail < 0 )
+	{
+# ifdef linux
+	    FILE *f;
+	    char buf[ 128 ];
+	    long kb;
+
+	    if( f = fopen( "/proc/loadavg", "r" ) )
+	    {
+		if( fscanf( f, "%lf", &load ) != 1 )
+		    load = 0.0;
+		fclose( f );
+	    }
+
+	    if( f = fopen( "/proc/meminfo", "r" ) )
+	    {
+		while( fgets( buf, sizeof( buf ), f ) )
+		    if( sscanf( buf, "MemAvailable: %ld", &kb ) == 1 )
+		{
+		    avail = kb / 1024;
+		    break;
+		}
+		fclose( f );
+	    }
 # endif
+	    if( avail < 0 )
+		avail = globs.memfree;
+
+	    last = now;
+	    execstarted = 0;
+
+	    if( DEBUG_EXECCMD )
+		printf( "load %.2f, %d MB available\n", load, avail );
+	}
+
+	return globs.load > 0.0 && load + execstarted >= globs.load ||
+	       globs.memfree > 0 && avail < globs.memfree;
+}
 
 /*
- * execunix.c - execute a shell script on UNIX/WinNT/OS2
- *
- * If $(JAMSHELL) is defined, uses that to formulate execvp()/spawnvp().
- * The default is:
- *
- *	/bin/sh -c %		[ on UNIX ]
- *	cmd.exe /c %		[ on OS2/WinNT ]
- *
- * Each word must be an individual element in a jam variable value.
- *
- * In $(JAMSHELL), % expands to the command string and ! expands to 
- * the slot number (starting at 1) for multiprocess (-j) invocations.
- * If $(JAMSHELL) doesn't include a %, it is tacked on as the last
- * argument.
- *
- * Don't just set JAMSHELL to /bin/sh or cmd.exe - it won't work!
- *
- * External routines:
- *	execcmd() - launch an async command execution
- * 	execwait() - wait and drive at most one execution completion
- *
- * Internal routines:
- *	onintr() - bump intr to note command interruption
+ * jsinit() - join the jobserver in MAKEFLAGS, or start one for -j
+ */
+
+static void
+jsinit()
+{
+	char	*mf = getenv( "MAKEFLAGS" );
+	char	*a, *e;
+	char	buf[ MAXJPATH ];
+	int	r, w, p[2];
+
+	/* A jobserver above us?  --jobserver-fds is the pre-4.2 name. */
+
+	if( mf && ( ( a = strstr( mf, "--jobserver-auth=" ) ) ||
+		    ( a = strstr( mf, "--jobserver-fds=" ) ) ) )
+	{
+	    a = strchr( a, '=' ) + 1;
+
+	    if( !strncmp( a, "fifo:", 5 ) )
+	    {
+		for( e = a += 5; *e && !isspace( *e ); e++ )
+		    ;
+
+		if( e - a < MAXJPATH )
+		{
+		    memcpy( buf, a, e - a );
+		    buf[ e - a ] = '\0';
+
+		    if( ( jsread = open( buf, O_RDONLY | O_NONBLOCK ) ) >= 0 )
+			jswrite = open( buf, O_WRONLY );
+		}
+	    }
+	    else if( sscanf( a, "%d,%d", &r, &w ) == 2 &&
+		    fcntl( r, F_GETFD ) >= 0 && fcntl( w, F_GETFD ) >= 0 )
+	    {
+		jsread = jsopen( r );
+		jswrite = dup( w );
+	    }
+
+	    if( jsread < 0 || jswrite < 0 )
+	    {
+		if( jsread >= 0 )
+		    close( jsread );
+		if( jswrite >= 0 )
+		    close( jswrite );
+
+		jsread = jswrite = -1;
+
+		printf( "warning: jobserver unavailable: using -j%d\n",
+			globs.jobs );
+		return;
+	    }
+
+	    fcntl( jsread, F_SETFD, FD_CLOEXEC );
+	    fcntl( jswrite, F_SETFD, FD_CLOEXEC );
+
+	    /* The jobserver sets the pace, so don't hold it back */
+	    /* with the default -j1. */
+
+	    if( globs.jobs == 1 )
+	    {
+# ifdef _SC_NPROCESSORS_ONLN
+		globs.jobs = sysconf( _SC_NPROCESSORS_ONLN );
+# endif
+		if( globs.jobs < 2 )
+		    globs.jobs = 2;
+	    }
+
+	    if( DEBUG_EXECCMD )
+		printf( "jobserver: joined %s\n", mf );
+
+	    return;
+	}
+
+	/* Otherwise, with -j, be the jobserver: a pipe holding a */
+	/* token for each slot beyond the first.  Its fds are left */
+	/* open across exec, for the children. */
+
+	if( globs.jobs < 2 || pipe( p ) < 0 )
+	    return;
+
+	if( ( jsread = jsopen( p[0] ) ) < 0 )
+	{
+	    close( p[0] );
+	    close( p[1] );
+	    return;
+	}
+
+	fcntl( jsread, F_SETFD, FD_CLOEXEC );
+	jswrite = p[1];
+
+	for( r = 1; r < globs.jobs; r++ )
+	    write( jswrite, "+", 1 );
+
+	sprintf( buf, " -j%d --jobserver-auth=%d,%d", globs.jobs, p[0], p[1] );
+
+	a = malloc( strlen( "MAKEFLAGS=" ) + ( mf ? strlen( mf ) : 0 ) +
+		strlen( buf ) + 1 );
+
+	sprintf( a, "MAKEFLAGS=%s%s", mf ? mf : "", buf );
+	putenv( a );
+
+	if( DEBUG_EXECCMD )
+	    printf( "jobserver: %s\n", a );
+}
+
+/*
+ * jsopen() - open a jobserver pipe for non-blocking reads
  *
- * 04/08/94 (seiwald) - Coherent/386 support added.
- * 05/04/94 (seiwald) - async multiprocess interface
- * 01/22/95 (seiwald) - $(JAMSHELL) support
- * 06/02/97 (gsar)    - full async multiprocess support for Win32
+ * Makes a new open file description, so O_NONBLOCK doesn't leak
+ * to others reading the same pipe.  Needs /proc (Linux).
  */
 
-static int intr = 0;
+static int
+jsopen( fd )
+int	fd;
+{
+	char buf[ 32 ];
 
-static int cmdsrunning = 0;
+	sprintf( buf, "/proc/self/fd/%d", fd );
 
-# ifdef NT
-static void (*istat)( int );
-void onintr( int );
-# else
-static void (*istat)();
-#endif
+	return open( buf, O_RDONLY | O_NONBLOCK );
+}
+
+/*
+ * jstake() - take a jobserver token, if one is waiting
+ *
+ * Returns 1 if we got one (or the jobserver went away), else 0.
+ */
 
-static struct
+static int
+jstake()
 {
-	int	pid;		/* on win32, a real process handle */
-	void	(*func)();
-	void 	*closure;
-# if defined( NT ) || defined( __OS2__ )
-	char	*tempfile;
-# endif
-} cmdtab[ MAXJOBS ] = {{0}};
+	char	c;
+	int	n;
+
+	while( ( n = read( jsread, &c, 1 ) ) < 0 && errno == EINTR )
+	    ;
+
+	if( n == 1 )
+	{
+	    jstokens[ njstokens++ ] = c;
+	    return 1;
+	}
+
+	if( n < 0 && errno == EAGAIN )
+	    return 0;
+
+	/* EOF: nobody's serving jobs any more */
+
+	close( jsread );
+	jsread = -1;
+
+	return 1;
+}
 
 /*
- * onintr() - bump intr to note command interruption
+ * jsgive() - give back tokens no longer needed
+ *
+ * N running commands need N-1 tokens.
  */
 
-void
-onintr( disp )
-int disp;
+static void
+jsgive()
 {
-	intr++;
-	printf( "...interrupted\n" );
+	while( njstokens && njstokens >= cmdsrunning )
+	{
+	    char c = jstokens[ --njstokens ];
+
+	    while( write( jswrite, &c, 1 ) < 0 && errno == EINTR )
+		;
+	}
 }
 
+# endif /* EXEC_POLL */
+
 /*
  * execcmd() - launch an async command execution
  */
 
 void
-execcmd( string, func, closure, shell )
+execcmd( string, func, closure, shell, flags )
 char *string;
 void (*func)();
 void *closure;
 LIST *shell;
+int flags;
 {
 	int pid;
 	int slot;
 	char *argv[ MAXARGC + 1 ];	/* +1 for NULL */
+	char jobno[ 12 ];		/* argv[] may point here */
+	char **direct = 0;
+	int launched = 0;
+# ifdef EXEC_POLL
+	struct cmdtab *c;
+	int capture = ( flags & EXEC_CAPTURE ) != 0;
+	int outp[2];
+# endif
 
 # if defined( NT ) || defined( __OS2__ )
 	static char *comspec;
@@ -127,18 +1192,44 @@ LIST *shell;
 	    comspec = "cmd.exe";
 # endif
 
-	/* Find a slot in the running commands table for this one. */
+	if( !cmdtab )
+	    execinit();
+
+# ifdef EXEC_POLL
+	/* Under a jobserver, each command beyond our first needs a */
+	/* token.  Wait for one, or for one of ours to finish. */
+
+	while( jsread >= 0 && cmdsrunning > njstokens && !jstake() )
+	{
+	    int want = jswant;
+	    int waited;
+
+	    jswant = 1;
+	    waited = execwait();
+	    jswant = want;
+
+	    if( !waited )
+		break;
+	}
+
+	/* With -l or -m, hold off while the machine is busy, */
+	/* unless nothing of ours is running. */
 
-	for( slot = 0; slot < MAXJOBS; slot++ )
-	    if( !cmdtab[ slot ].pid )
+	while( cmdsrunning && execbusy() )
+	    if( !execwait() )
 		break;
+# endif
 
-	if( slot == MAXJOBS )
+	/* Take a slot in the running commands table for this one. */
+
+	if( !ncmdfree )
 	{
 	    printf( "no slots for child!\n" );
 	    exit( EXITBAD );
 	}
 
+	slot = cmdfree[ --ncmdfree ];
+
 # if defined( NT ) || defined( __OS2__ )
 	if( !cmdtab[ slot ].tempfile )
 	{
@@ -185,12 +1276,30 @@ LIST *shell;
 
 	/* Forumulate argv */
 	/* If shell was defined, be prepared for % and ! subs. */
+	/* Otherwise, if it's simple enough, run the command directly. */
 	/* Otherwise, use stock /bin/sh (on unix) or comspec (on NT). */
 
+	/* A $(JAMSHELL) is used as is, never bypassed. */
+
+	if( shell )
+	    flags |= EXEC_SHELL;
+
+# ifdef EXEC_DIRECT
+	if( !( flags & EXEC_SHELL ) )
+	    direct = execsplit( string );
+
+	if( direct && DEBUG_EXECCMD )
+	{
+	    int i;
+
+	    for( i = 0; direct[i]; i++ )
+		printf( "argv[%d] = '%s'\n", i, direct[i] );
+	}
+# endif
+
 	if( shell )
 	{
 	    int i;
-	    char jobno[4];
 	    int gotpercent = 0;
 
 	    sprintf( jobno, "%d", slot + 1 );
@@ -239,28 +1348,108 @@ LIST *shell;
 	    exit( EXITBAD );
 	}
 # else
-	if ((pid = vfork()) == 0) 
-   	{
-		execvp( argv[0], argv );
-		_exit(127);
+	/* A capturing command gets a pipe for its stdout and stderr */
+	/* (workers have their own).  It's made when first needed. */
+
+	c = &cmdtab[ slot ];
+	c->worker = 0;
+	c->outlen = 0;
+	outp[0] = outp[1] = -1;
+
+# ifdef EXEC_DIRECT
+	/* If the program can't be spawned, let the shell have a go */
+	/* at it (argv[] is still /bin/sh -c): it reports 'not found' */
+	/* errors the usual way. */
+
+	if( direct )
+	{
+	    posix_spawn_file_actions_t fa;
+
+	    if( capture && execpipe( outp ) < 0 )
+	    {
+		perror( "pipe" );
+		exit( EXITBAD );
+	    }
+
+	    posix_spawn_file_actions_init( &fa );
+
+	    if( capture )
+	    {
+		posix_spawn_file_actions_adddup2( &fa, outp[1], 1 );
+		posix_spawn_file_actions_adddup2( &fa, outp[1], 2 );
+	    }
+
+	    launched = !posix_spawnp( &pid, direct[0], &fa, 0, direct, environ );
+
+	    posix_spawn_file_actions_destroy( &fa );
+	    free( (char *)direct );
+	}
+# endif
+
+	/* Anything else /bin/sh -c would get goes to the slot's worker */
+
+	if( !launched && !( flags & EXEC_SHELL ) &&
+	    !workerexec( &workers[ slot ], string, capture ) )
+	{
+	    pid = workers[ slot ].pid;
+	    launched = c->worker = 1;
 	}
 
-	if( pid == -1 )
+	if( !launched )
 	{
-	    perror( "vfork" );
-	    exit( EXITBAD );
+	    if( capture && outp[0] < 0 && execpipe( outp ) < 0 )
+	    {
+		perror( "pipe" );
+		exit( EXITBAD );
+	    }
+
+	    if ((pid = vfork()) == 0) 
+	    {
+		if( outp[1] >= 0 )
+		{
+		    dup2( outp[1], 1 );
+		    dup2( outp[1], 2 );
+		}
+		execvp( argv[0], argv );
+		_exit(127);
+	    }
+
+	    if( pid == -1 )
+	    {
+		perror( "vfork" );
+		exit( EXITBAD );
+	    }
 	}
+
+	/* Keep only our end of the output pipe */
+
+	if( outp[1] >= 0 )
+	    close( outp[1] );
+
+	if( c->worker && outp[0] >= 0 )
+	    close( outp[0] );
+
+	c->outfd = c->worker ? workers[ slot ].outfd : outp[0];
 # endif
 	/* Save the operation for execwait() to find. */
 
 	cmdtab[ slot ].pid = pid;
 	cmdtab[ slot ].func = func;
 	cmdtab[ slot ].closure = closure;
+	cmdtab[ slot ].start = execclock();
+
+# ifdef EXEC_POLL
+	if( !cmdtab[ slot ].worker )
+# endif
+	pidenter( pid, slot, 0 );
+
+# ifdef EXEC_POLL
+	execstarted++;
+# endif
 
 	/* Wait until we're under the limit of concurrent commands. */
-	/* Don't trust globs.jobs alone. */
 
-	while( cmdsrunning >= MAXJOBS || cmdsrunning >= globs.jobs )
+	while( cmdsrunning >= cmdmax )
 	    if( !execwait() )
 		break;
 }
@@ -273,14 +1462,21 @@ int
 execwait()
 {
 	int i;
-	int status, w;
-	int rstat;
+	int status;
+# ifndef EXEC_POLL
+	int w;
+	struct pident *p;
+# endif
 
 	/* Handle naive make1() which doesn't know if cmds are running. */
 
 	if( !cmdsrunning )
 	    return 0;
 
+# ifdef EXEC_POLL
+	if( ( i = execpoll( &status, -1 ) ) < 0 )
+	    return 1;
+# else
 	/* Pick up process pid and status */
     
 	while( ( w = wait( &status ) ) == -1 && errno == EINTR )
@@ -295,33 +1491,131 @@ execwait()
 
 	/* Find the process in the cmdtab. */
 
-	for( i = 0; i < MAXJOBS; i++ )
-	    if( w == cmdtab[ i ].pid )
-		break;
-
-	if( i == MAXJOBS )
+	if( !( p = pidfind( w ) ) )
 	{
 	    printf( "waif child found!\n" );
 	    exit( EXITBAD );
 	}
 
-	/* Drive the completion */
+	i = p->slot;
+	piddelete( w );
+	status = EXITCODE( status );
+# endif
+
+	execdone( i, status );
+
+	return 1;
+}
+
+/*
+ * execcheck() - drive the completions of commands already finished
+ *
+ * Unlike execwait(), doesn't wait: make1() calls it to keep commands
+ * going while make0() is still binding targets.  Without poll(), it
+ * can't tell, so does nothing.
+ */
+
+int
+execcheck()
+{
+	int n = 0;
+# ifdef EXEC_POLL
+	int i;
+	int status;
+
+	while( cmdsrunning && ( i = execpoll( &status, 0 ) ) >= 0 )
+	{
+	    execdone( i, status );
+	    n++;
+	}
+# endif
+
+	return n;
+}
+
+/*
+ * execdone() - drive a command's completion
+ */
+
+static void
+execdone( i, status )
+int	i;
+int	status;
+{
+	int rstat;
+	char *output = 0;
+	EXECINFO info;
 
 	if( !--cmdsrunning )
 	    signal( SIGINT, istat );
 
+# ifdef EXEC_POLL
+	if( jsread >= 0 || njstokens )
+	    jsgive();
+# endif
+
 	if( intr )
 	    rstat = EXEC_CMD_INTR;
-	else if( w == -1 || status != 0 )
+	else if( status != 0 )
 	    rstat = EXEC_CMD_FAIL;
 	else
 	    rstat = EXEC_CMD_OK;
 
 	cmdtab[ i ].pid = 0;
+	cmdfree[ ncmdfree++ ] = i;
 
-	(*cmdtab[ i ].func)( cmdtab[ i ].closure, rstat );
+	/* Commands run by a worker share its rusage, so we */
+	/* only know that of those we waited for ourselves. */
 
-	return 1;
+	info.slot = i + 1;
+	info.exitcode = status;
+	info.start = cmdtab[ i ].start;
+	info.end = execclock();
+	info.user = info.sys = -1;
+	info.maxrss = -1;
+
+# ifdef EXEC_POLL
+	if( cmdtab[ i ].haveru )
+	{
+	    struct rusage *ru = &cmdtab[ i ].ru;
+
+	    info.user = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6;
+	    info.sys = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+	    info.maxrss = ru->ru_maxrss;
+	    cmdtab[ i ].haveru = 0;
+	}
+# endif
+
+	/* Captured output goes to the completion function, which */
+	/* is done with it before this slot can be reused. */
+
+# ifdef EXEC_POLL
+	if( cmdtab[ i ].outlen )
+	{
+	    cmdtab[ i ].out[ cmdtab[ i ].outlen ] = '\0';
+	    output = cmdtab[ i ].out;
+	}
+# endif
+
+	(*cmdtab[ i ].func)( cmdtab[ i ].closure, rstat, output, &info );
+}
+
+/*
+ * execclock() - the time, in seconds, for EXECINFO
+ */
+
+static double
+execclock()
+{
+# ifdef EXEC_POLL
+	struct timeval tv;
+
+	gettimeofday( &tv, (struct timezone *)0 );
+
+	return tv.tv_sec + tv.tv_usec / 1e6;
+# else
+	return (double)time( (time_t *)0 );
+# endif
 }
 
 # if defined( NT ) && !defined( __BORLANDC__ )
@@ -339,12 +1633,12 @@ int *status;
 	static HANDLE *active_handles = 0;
 
 	if (!active_handles)
-	    active_handles = (HANDLE *)malloc(globs.jobs * sizeof(HANDLE) );
+	    active_handles = (HANDLE *)malloc(cmdmax * sizeof(HANDLE) );
 
 	/* first see if any non-waited-for processes are dead,
 	 * and return if so.
 	 */
-	for ( i = 0; i < globs.jobs; i++ ) {
+	for ( i = 0; i < cmdmax; i++ ) {
 	    if ( cmdtab[i].pid ) {
 		if ( GetExitCodeProcess((HANDLE)cmdtab[i].pid, &exitcode) ) {
 		    if ( exitcode == STILL_ACTIVE )
@@ -47,11 +47,12 @@
 char tempnambuf[ L_tmpnam + 1 + 4 ] = {0};
 
 void
-execcmd( string, func, closure, shell )
+execcmd( string, func, closure, shell, flags )
 char *string;
 void (*func)();
 void *closure;
 LIST *shell;
+int flags;
 {
 	char *s, *e, *p;
 	int rstat = EXEC_CMD_OK;
@@ -89,7 +90,7 @@ LIST *shell;
 	    if( !( f = fopen( tempnambuf + 1, "w" ) ) )
 	    {
 		printf( "can't open command file\n" );
-		(*func)( closure, EXEC_CMD_FAIL );
+		(*func)( closure, EXEC_CMD_FAIL, (char *)0 );
 		return;
 	    }
 
@@ -155,7 +156,7 @@ LIST *shell;
 	if( status == 2 || status == 4 )
 	    rstat = EXEC_CMD_FAIL;
 
-	(*func)( closure, rstat );
+	(*func)( closure, rstat, (char *)0, (EXECINFO *)0 );
 }
 
 int 
@@ -164,4 +165,15 @@ execwait()
 	return 0;
 }
 
+int 
+execcheck()
+{
+	return 0;
+}
+
+void
+execinit()
+{
+}
+
 # endif /* VMS */
@@ -46,5 +46,6 @@ void file_parent();
 
 void file_archscan();
 void file_dirscan();
+void file_dirscan_r();
 
 int file_time();
@@ -54,6 +54,7 @@ struct ar_hdr		/* archive file member header - printable ascii */
  * External routines:
  *
  *	file_dirscan() - scan a directory for files
+ *	file_dirscan_r() - scan a directory for files and time them
  *	file_time() - get timestamp of file, if not done by file_dirscan()
  *	file_archscan() - scan an archive for files
  *
@@ -63,6 +64,10 @@ struct ar_hdr		/* archive file member header - printable ascii */
  * file.   If file_dirscan() or file_archscan() do not provide the file's
  * timestamp, interested parties may later call file_time().
  *
+ * File_dirscan_r() is safe to call from a thread of the pool (see
+ * tpool.c): it passes its callback an argument of the caller's, for
+ * it to collect the files in, and stat()s them itself.
+ *
  * 04/08/94 (seiwald) - Coherent/386 support added.
  * 12/19/94 (mikem) - solaris string table insanity support
  * 02/14/95 (seiwald) - parse and build /xxx properly
@@ -128,6 +133,76 @@ void	(*func)();
 	closedir( d );
 }
 
+/*
+ * file_dirscan_r() - scan a directory for files and time them
+ *
+ * Calls (*func)( arg, filename, found, time ) for each file, as
+ * file_dirscan() does, but with the timestamp of each plain file or
+ * symlink.  Where the system has them, d_type tells which those are
+ * and fstatat() saves looking up the directory again for each.  Other
+ * files (directories mostly) are left for file_time().
+ */
+
+# if defined( AT_FDCWD ) && defined( DT_UNKNOWN )
+# define FILE_STATAT
+# endif
+
+void
+file_dirscan_r( dir, func, arg )
+char	*dir;
+void	(*func)();
+void	*arg;
+{
+	FILENAME f;
+	DIR *d;
+#ifdef NeXT
+	struct direct *dirent;
+#else
+	struct dirent *dirent;
+#endif
+	struct stat statbuf;
+	char filename[ MAXJPATH ];
+	int found;
+
+	memset( (char *)&f, '\0', sizeof( f ) );
+
+	f.f_dir.ptr = dir;
+	f.f_dir.len = strlen(dir);
+
+	dir = *dir ? dir : ".";
+
+	if( f.f_dir.len == 1 && f.f_dir.ptr[0] == '/' )
+	    (*func)( arg, dir, 0 /* not stat()'ed */, (time_t)0 );
+
+	if( !( d = opendir( dir ) ) )
+	    return;
+
+	while( dirent = readdir( d ) )
+	{
+# ifdef old_sinix
+	    f.f_base.ptr = dirent->d_name - 2;
+# else
+	    f.f_base.ptr = dirent->d_name;
+# endif
+	    f.f_base.len = strlen( f.f_base.ptr );
+
+	    file_build( &f, filename, 0 );
+
+# ifdef FILE_STATAT
+	    found = ( dirent->d_type == DT_REG || 
+		      dirent->d_type == DT_LNK ||
+		      dirent->d_type == DT_UNKNOWN ) &&
+		    !fstatat( dirfd( d ), f.f_base.ptr, &statbuf, 0 );
+# else
+	    found = !stat( filename, &statbuf );
+# endif
+
+	    (*func)( arg, filename, found, found ? statbuf.st_mtime : 0 );
+	}
+
+	closedir( d );
+}
+
 /*
  * file_time() - get timestamp of file, if not done by file_dirscan()
  */
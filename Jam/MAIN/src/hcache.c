@@ -0,0 +1,363 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "variable.h"
+# include "hash.h"
+# include "newstr.h"
+# include "hcache.h"
+
+/*
+ * hcache.c - remember what header scans found, across runs
+ *
+ * If $(HCACHEFILE) names a file, it holds the include names each
+ * file's header scan found, along with the file's modification time
+ * and size and the $(HDRSCAN) patterns it was scanned with.  While
+ * these all still match, headers() takes the names from the cache
+ * instead of reading the file again.
+ *
+ * The file starts with a version line, and then has one entry per
+ * scanned file:
+ *
+ *	<time> <size> <age> <#patterns> <#includes> <file name>
+ *	<pattern>		(one line for each)
+ *	<include name>		(one line for each)
+ *
+ * <age> counts the runs since the entry was last used: entries not
+ * used in HCACHE_MAXAGE runs are dropped, so files that go away don't
+ * stay in the cache forever.
+ *
+ * External routines:
+ *
+ *	hcache_get() - get the include names of a file, if still valid
+ *	hcache_put() - remember the include names of a file
+ *	hcache_done() - write the cache file back, if anything changed
+ *
+ * Internal routines:
+ *
+ *	hcache_init() - read the cache file named by $(HCACHEFILE)
+ *	hcache_size() - get the size of a file, or -1 if it's not there
+ *	hcache_read() - read one line of the cache file
+ */
+
+# define HCACHE_VERSION "# jam header cache 1\n"
+# define HCACHE_MAXAGE 100
+
+typedef struct _hcache HCACHE;
+
+struct _hcache {
+	char	*name;		/* bound name of the file */
+	time_t	time;
+	long	size;
+	int	age;		/* runs since last used */
+	LIST	*hdrscan;	/* patterns it was scanned with */
+	LIST	*includes;	/* what they found */
+	HCACHE	*next;		/* for hcache_done() */
+} ;
+
+static struct hash *hcachehash = 0;
+static HCACHE *hcachelist = 0;
+static char *hcachefile = 0;
+static int hcachedirty = 0;
+
+static void hcache_init();
+static long hcache_size();
+static int hcache_read();
+
+/*
+ * hcache_init() - read the cache file named by $(HCACHEFILE)
+ */
+
+static void
+hcache_init()
+{
+	LIST	*l;
+	FILE	*f;
+	char	buf[ 1024 ];
+	HCACHE	hcache, *c = &hcache;
+	int	nscan, ninc, age, n;
+	long	time, size;
+
+	if( hcachehash )
+	    return;
+
+	hcachehash = hashinit( sizeof( HCACHE ), "hcache" );
+
+	if( !( l = var_get( "HCACHEFILE" ) ) )
+	    return;
+
+	hcachefile = l->string;
+
+	if( !( f = fopen( hcachefile, "r" ) ) )
+	    return;
+
+	if( !hcache_read( buf, sizeof( buf ), f ) ||
+	    strcmp( buf, HCACHE_VERSION ) )
+	{
+	    printf( "warning: ignoring header cache %s\n", hcachefile );
+	    fclose( f );
+	    return;
+	}
+
+	while( hcache_read( buf, sizeof( buf ), f ) )
+	{
+	    c = &hcache;
+
+	    if( sscanf( buf, "%ld %ld %d %d %d %n",
+			&time, &size, &age, &nscan, &ninc, &n ) < 5 )
+		break;
+
+	    buf[ strlen( buf ) - 1 ] = '\0';
+	    c->name = buf + n;
+
+	    if( hashenter( hcachehash, (HASHDATA **)&c ) )
+	    {
+		c->name = newstr( c->name );
+		c->next = hcachelist;
+		hcachelist = c;
+	    }
+	    else
+	    {
+		list_free( c->hdrscan );
+		list_free( c->includes );
+	    }
+
+	    c->time = time;
+	    c->size = size;
+	    c->age = age;
+	    c->hdrscan = 0;
+	    c->includes = 0;
+
+	    for( ; nscan + ninc; nscan ? nscan-- : ninc-- )
+	    {
+		if( !hcache_read( buf, sizeof( buf ), f ) )
+		    break;
+
+		buf[ strlen( buf ) - 1 ] = '\0';
+
+		if( nscan )
+		    c->hdrscan = list_new( c->hdrscan, newstr( buf ) );
+		else
+		    c->includes = list_new( c->includes, newstr( buf ) );
+	    }
+
+	    /* A short entry can't be trusted: nor can the rest. */
+
+	    if( nscan + ninc )
+	    {
+		c->size = -1;
+		break;
+	    }
+	}
+
+	fclose( f );
+
+	if( DEBUG_HEADER )
+	    printf( "read header cache from %s\n", hcachefile );
+}
+
+/*
+ * hcache_read() - read one line of the cache file
+ *
+ * Returns 0 at EOF, or if the line is too long to be one jam wrote.
+ */
+
+static int
+hcache_read( buf, len, f )
+char	*buf;
+int	len;
+FILE	*f;
+{
+	return fgets( buf, len, f ) && strchr( buf, '\n' );
+}
+
+/*
+ * hcache_size() - get the size of a file, or -1 if it's not there
+ */
+
+static long
+hcache_size( file )
+char	*file;
+{
+	struct stat statbuf;
+
+	if( stat( file, &statbuf ) < 0 )
+	    return -1;
+
+	return statbuf.st_size;
+}
+
+/*
+ * hcache_get() - get the include names of a file, if still valid
+ *
+ * Returns 1 and a new LIST of the names if the file's time, size
+ * and $(HDRSCAN) patterns are those it was last scanned with.
+ */
+
+int
+hcache_get( file, time, hdrscan, includes )
+char	*file;
+time_t	time;
+LIST	*hdrscan;
+LIST	**includes;
+{
+	HCACHE	hcache, *c = &hcache;
+	LIST	*l;
+
+	hcache_init();
+
+	if( !hcachefile )
+	    return 0;
+
+	c->name = file;
+
+	if( !hashcheck( hcachehash, (HASHDATA **)&c ) ||
+	    c->time != time ||
+	    c->size != hcache_size( file ) )
+		return 0;
+
+	for( l = c->hdrscan; l && hdrscan; l = list_next( l ) )
+	{
+	    if( strcmp( l->string, hdrscan->string ) )
+		return 0;
+	    hdrscan = list_next( hdrscan );
+	}
+
+	if( l || hdrscan )
+	    return 0;
+
+	if( DEBUG_HEADER )
+	    printf( "header cache hit %s\n", file );
+
+	if( c->age > 1 )
+	    hcachedirty = 1;
+
+	c->age = 0;
+	*includes = list_copy( L0, c->includes );
+
+	return 1;
+}
+
+/*
+ * hcache_put() - remember the include names of a file
+ */
+
+void
+hcache_put( file, time, hdrscan, includes )
+char	*file;
+time_t	time;
+LIST	*hdrscan;
+LIST	*includes;
+{
+	HCACHE	hcache, *c = &hcache;
+	LIST	*l;
+
+	hcache_init();
+
+	if( !hcachefile )
+	    return;
+
+	/* Strings with newlines can't be written back. */
+
+	for( l = hdrscan; l; l = list_next( l ) )
+	    if( strchr( l->string, '\n' ) )
+		return;
+
+	for( l = includes; l; l = list_next( l ) )
+	    if( strchr( l->string, '\n' ) )
+		return;
+
+	c->name = file;
+
+	if( hashenter( hcachehash, (HASHDATA **)&c ) )
+	{
+	    c->name = newstr( file );
+	    c->next = hcachelist;
+	    hcachelist = c;
+	}
+	else
+	{
+	    list_free( c->hdrscan );
+	    list_free( c->includes );
+	}
+
+	c->time = time;
+	c->size = hcache_size( file );
+	c->age = 0;
+	c->hdrscan = list_copy( L0, hdrscan );
+	c->includes = list_copy( L0, includes );
+
+	hcachedirty = 1;
+}
+
+/*
+ * hcache_done() - write the cache file back, if anything changed
+ *
+ * Like the history file, it's written to a temporary file that is
+ * renamed into place.
+ */
+
+void
+hcache_done()
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	HCACHE	*c;
+	LIST	*l;
+	int	nscan, ninc;
+
+	/* Entries not used this run have aged, even if none was; */
+	/* those used again go back to age 1. */
+
+	hcache_init();
+
+	for( c = hcachelist; c; c = c->next )
+	    if( c->age )
+		hcachedirty = 1;
+
+	if( !hcachefile || !hcachedirty )
+	    return;
+
+	if( strlen( hcachefile ) + 5 > MAXJPATH )
+	    return;
+
+	sprintf( tmp, "%s.new", hcachefile );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "can't write header cache %s\n", tmp );
+	    return;
+	}
+
+	fputs( HCACHE_VERSION, f );
+
+	for( c = hcachelist; c; c = c->next )
+	{
+	    if( c->size < 0 || c->age >= HCACHE_MAXAGE )
+		continue;
+
+	    for( nscan = 0, l = c->hdrscan; l; l = list_next( l ) )
+		nscan++;
+
+	    for( ninc = 0, l = c->includes; l; l = list_next( l ) )
+		ninc++;
+
+	    fprintf( f, "%ld %ld %d %d %d %s\n",
+		(long)c->time, c->size, c->age + 1, nscan, ninc, c->name );
+
+	    for( l = c->hdrscan; l; l = list_next( l ) )
+		fprintf( f, "%s\n", l->string );
+
+	    for( l = c->includes; l; l = list_next( l ) )
+		fprintf( f, "%s\n", l->string );
+	}
+
+	if( fclose( f ) || rename( tmp, hcachefile ) )
+	    printf( "can't write header cache %s\n", hcachefile );
+
+	hcachedirty = 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * hcache.h - remember what header scans found, across runs
+ */
+
+int hcache_get();
+void hcache_put();
+void hcache_done();
@@ -13,6 +13,16 @@
 # include "regexp.h"
 # include "headers.h"
 # include "newstr.h"
+# include "trace.h"
+# include "hash.h"
+# include "tpool.h"
+# include "hcache.h"
+# include "search.h"
+#ifdef FATFS
+# include "timestam.h"
+#else
+# include "timestamp.h"
+#endif
 
 /*
  * headers.c - handle #includes in source files
@@ -23,23 +33,94 @@
  * 
  *	$(HDRRULE) <target> : <include files> ;
  *
+ * With -j, make0() hands each file it is about to reach to
+ * headers_prefetch(), which scans it on a thread of the pool (see
+ * tpool.c), so that headers() need only collect the result.  Only the
+ * scan is done off the main thread: the LIST and the HDRRULE call are
+ * not.  As an earlier HDRRULE can still change where the file binds or
+ * its $(HDRSCAN), headers() takes the result only if those are the
+ * same when it gets to the file.
+ *
+ * If $(HCACHEFILE) is set, the names found in each file are kept
+ * there (see hcache.c), and files that haven't changed since are not
+ * scanned again.
+ *
+ * If $(DEPFILE) is set on a target, it names the target of a depfile
+ * the compiler wrote when it last compiled the file (as with gcc -MD).
+ * While that is newer than the file, headers() makes the headers it
+ * lists the file's INCLUDES directly, instead of scanning.
+ *
  * External routines:
  *    headers() - scan a target for include files and call HDRRULE
+ *    headers_prefetch() - start scanning a target on the thread pool
  *
  * Internal routines:
- *    headers1() - using regexp, scan a file and build include LIST
+ *    headers_same() - was a prefetched scan of the file headers() wants?
+ *    headers_depfile() - take a target's INCLUDES from a depfile
+ *    hdrread() - read a whole file into a buffer
+ *    hdrscan_new() - set up a scan of a file with $(HDRSCAN)
+ *    hdrscan_re() - compile a $(HDRSCAN) pattern, once per run
+ *    hdrscan_free() - free a scan
+ *    headers1() - using regexp, scan a file for include names
  *
  * 04/13/94 (seiwald) - added shorthand L0 for null list pointer
  */
 
-static LIST *headers1();
+/*
+ * HDRSCAN - a scan of one file, done by headers1()
+ *
+ * A scan may run on a pool thread.  It only reads the compiled
+ * regexps it shares with other scans, matching them all at once with
+ * regset_exec(), and leaves the names it finds in found[],
+ * NUL-terminated one after another, for headers() to make into a LIST.
+ */
+
+typedef struct _hdrscan HDRSCAN;
+
+struct _hdrscan {
+	TJOB	job;			/* must be first */
+	char	*file;			/* t->boundname */
+	int	rec;
+	regexp	**re;			/* from hdrscan_re() */
+	char	*found;
+	int	len;
+	int	size;
+} ;
+
+/* Scans started (or found in the cache) by headers_prefetch() */
+
+struct hdrjob {
+	char	*name;
+	char	*boundname;		/* where it was bound then */
+	time_t	time;
+	LIST	*hdrscan;		/* $(HDRSCAN) then */
+	HDRSCAN	*scan;
+	LIST	*includes;		/* from hcache_get() */
+} ;
+
+static struct hash *hdrjobs = 0;
+
+/* Compiled $(HDRSCAN) patterns, by pattern, kept for the whole run */
+
+struct hdrre {
+	char	*name;
+	regexp	*re;
+} ;
+
+static struct hash *hdrres = 0;
+
+static int headers_depfile();
+static int headers_same();
+static char *hdrread();
+static HDRSCAN *hdrscan_new();
+static regexp *hdrscan_re();
+static void hdrscan_free();
+static void headers1();
 
 /*
  * headers() - scan a target for include files and call HDRRULE
  */
 
-# define MAXINC 10
-
 void
 headers( t )
 TARGET *t;
@@ -48,32 +129,84 @@ TARGET *t;
 	LIST	*hdrrule;
 	LIST	*headlist = 0;
 	PARSE	p[3];
-	regexp	*re[ MAXINC ];
-	int	rec = 0;
+	LIST	*depfile;
+	HDRSCAN	*scan = 0;
+	struct hdrjob hj, *h = &hj;
+	char	*s;
+	double	start;
+
+	/* A good depfile says all there is to say. */
+
+	if( ( depfile = var_get( "DEPFILE" ) ) &&
+	    headers_depfile( t, depfile->string ) )
+		return;
 
 	if( !( hdrscan = var_get( "HDRSCAN" ) ) || 
 	    !( hdrrule = var_get( "HDRRULE" ) ) )
 	        return;
 
+	start = trace_now();
+
 	if( DEBUG_HEADER )
 	    printf( "header scan %s\n", t->name );
 
-	/* Compile all regular expressions in HDRSCAN */
+	/* Collect what headers_prefetch() started, or take the names */
+	/* from the header cache, or scan now. */
 
-	while( rec < MAXINC && hdrscan )
+	h->name = t->name;
+
+	if( hdrjobs && hashcheck( hdrjobs, (HASHDATA **)&h ) && 
+	    ( h->scan || h->includes ) )
 	{
-	    re[rec++] = regcomp( hdrscan->string );
-	    hdrscan = list_next( hdrscan );
+	    scan = h->scan;
+	    headlist = h->includes;
+	    h->scan = 0;
+	    h->includes = 0;
+
+	    if( scan )
+		tpool_wait( &scan->job );
+
+	    if( !headers_same( h, t, hdrscan ) )
+	    {
+		if( scan )
+		    hdrscan_free( scan );
+		list_free( headlist );
+		scan = 0;
+		headlist = 0;
+	    }
+	}
+
+	if( !scan && !headlist &&
+	    !hcache_get( t->boundname, t->time, hdrscan, &headlist ) )
+	{
+	    scan = hdrscan_new( t->boundname );
+	    headers1( &scan->job );
+	}
+
+	/* A fresh scan's names go into the header cache. */
+
+	if( scan )
+	{
+	    for( s = scan->found; s < scan->found + scan->len; 
+		 s += strlen( s ) + 1 )
+	    {
+		if( DEBUG_HEADER )
+		    printf( "header found: %s\n", s );
+
+		headlist = list_new( headlist, newstr( s ) );
+	    }
+
+	    hdrscan_free( scan );
+	    hcache_put( t->boundname, t->time, hdrscan, headlist );
 	}
 
 	/* Doctor up call to HDRRULE rule */
-	/* Call headers1() to get LIST of included files. */
 
 	p[0].string = hdrrule->string;
 	p[0].left = &p[1];
 	p[1].llist = list_new( L0, t->name );
 	p[1].left = &p[2];
-	p[2].llist = headers1( headlist, t->boundname, rec, re );
+	p[2].llist = headlist;
 	p[2].left = 0;
 
 	if( p[2].llist )
@@ -83,50 +216,392 @@ TARGET *t;
 	    compile_rule( p, &lol0 );
 	}
 
+	trace_span( "headers", t->boundname, start );
+
 	/* Clean up */
 
 	list_free( p[1].llist );
 	list_free( p[2].llist );
+}
+
+/*
+ * headers_prefetch() - start scanning a target on the thread pool
+ *
+ * Called, like headers(), with the target's settings pushed, with
+ * where the target would be bound now and its time there: make0()
+ * binds it for real only when it gets to it.  Does nothing without -j
+ * or threads.  A file the header cache knows needs no scan at all.
+ */
+
+void
+headers_prefetch( t, boundname, time )
+TARGET	*t;
+char	*boundname;
+time_t	time;
+{
+	HDRSCAN	*scan;
+	struct hdrjob hj, *h = &hj;
 
-	while( rec )
-	    free( (char *)re[--rec] );
+	if( globs.jobs < 2 || !var_get( "HDRSCAN" ) || !var_get( "HDRRULE" ) )
+	    return;
+
+	if( var_get( "DEPFILE" ) )
+	    return;
+
+	if( !tpool_init( globs.jobs, 4 * globs.jobs ) )
+	    return;
+
+	if( !hdrjobs )
+	    hdrjobs = hashinit( sizeof( struct hdrjob ), "hdrjobs" );
+
+	h->name = t->name;
+
+	h->scan = 0;
+	h->includes = 0;
+
+	if( !hashenter( hdrjobs, (HASHDATA **)&h ) )
+	    return;
+
+	h->boundname = boundname;
+	h->time = time;
+	h->hdrscan = list_copy( L0, var_get( "HDRSCAN" ) );
+
+	if( hcache_get( boundname, time, h->hdrscan, &h->includes ) )
+	    return;
+
+	h->scan = scan = hdrscan_new( boundname );
+
+	if( !tpool_submit( &scan->job ) )
+	{
+	    h->scan = 0;
+	    hdrscan_free( scan );
+	}
+}
+
+/*
+ * headers_same() - was a prefetched scan of the file headers() wants?
+ *
+ * The same file, at the same time, with the same $(HDRSCAN).
+ */
+
+static int
+headers_same( h, t, hdrscan )
+struct hdrjob *h;
+TARGET	*t;
+LIST	*hdrscan;
+{
+	LIST	*l = h->hdrscan;
+
+	if( h->boundname != t->boundname || h->time != t->time )
+	    return 0;
+
+	for( ; l && hdrscan; l = list_next( l ) )
+	{
+	    if( l->string != hdrscan->string )
+		return 0;
+
+	    hdrscan = list_next( hdrscan );
+	}
+
+	return !l && !hdrscan;
 }
 
 /*
- * headers1() - using regexp, scan a file and build include LIST
+ * headers_depfile() - take a target's INCLUDES from a depfile
+ *
+ * The depfile is in make(1) syntax:
+ *
+ *	object: source header header \
+ *	  header ...
+ *
+ * Only the first rule is read; the source itself is skipped.  If the
+ * depfile is missing, older than the target, or names a header that is
+ * gone, returns 0 and the target must be scanned as usual.
  */
 
-static LIST *
-headers1( l, file, rec, re )
-LIST	*l;
+static int
+headers_depfile( t, name )
+TARGET	*t;
+char	*name;
+{
+	TARGET	*d = bindtarget( name );
+	LIST	*includes = 0;
+	char	path[ MAXJPATH ];
+	char	*buf, *p, *q;
+	int	len, deps = 0;
+	time_t	time;
+
+	/* Bind the depfile as make0() would. */
+
+	if( d->binding == T_BIND_UNBOUND )
+	{
+	    pushsettings( d->settings );
+	    d->boundname = search( d->name, &d->time );
+	    d->binding = d->time ? T_BIND_EXISTS : T_BIND_MISSING;
+	    popsettings( d->settings );
+	}
+
+	if( d->binding != T_BIND_EXISTS || d->time < t->time )
+	    return 0;
+
+	if( !( buf = hdrread( d->boundname, &len ) ) )
+	    return 0;
+
+	/* Pick out the names after the first unescaped ':' */
+	/* that ends a word, up to the first unescaped newline. */
+
+	for( p = buf; *p && *p != '\n'; )
+	{
+	    /* Skip blanks and escaped newlines. */
+
+	    if( *p == ' ' || *p == '\t' || *p == '\r' )
+	    {
+		p++;
+		continue;
+	    }
+
+	    if( p[0] == '\\' && ( p[1] == '\n' || p[1] == '\r' ) )
+	    {
+		p += 2;
+		continue;
+	    }
+
+	    /* Copy a word, unescaping "\ ", "\#" and "$$". */
+
+	    for( q = path; *p && !strchr( " \t\r\n", *p ); p++ )
+	    {
+		if( p[0] == '\\' && ( p[1] == '\n' || p[1] == '\r' ) )
+		    break;
+		else if( p[0] == '\\' && strchr( " \t#", p[1] ) )
+		    p++;
+		else if( p[0] == '$' && p[1] == '$' )
+		    p++;
+
+		if( q < path + MAXJPATH - 1 )
+		    *q++ = *p;
+	    }
+
+	    *q = '\0';
+
+	    if( !deps )
+	    {
+		deps = q > path && q[-1] == ':';
+		continue;
+	    }
+
+	    if( q == path + MAXJPATH - 1 || !strcmp( path, t->boundname ) )
+		continue;
+
+	    /* A header that's gone means the depfile is out of date. */
+
+	    timestamp( path, &time );
+
+	    if( !time )
+	    {
+		list_free( includes );
+		free( buf );
+		return 0;
+	    }
+
+	    includes = list_new( includes, newstr( path ) );
+	}
+
+	free( buf );
+
+	if( !deps )
+	    return 0;
+
+	if( DEBUG_HEADER )
+	{
+	    printf( "header depfile %s: ", d->boundname );
+	    list_print( includes );
+	    printf( "\n" );
+	}
+
+	t->deps[ T_DEPS_INCLUDES ] = 
+		targetlist( t->deps[ T_DEPS_INCLUDES ], includes );
+
+	list_free( includes );
+
+	return 1;
+}
+
+/*
+ * hdrread() - read a whole file into a buffer
+ *
+ * Returns a malloc'd buffer, NUL-terminated, with its length in *len;
+ * or 0 if the file can't be opened.
+ */
+
+static char *
+hdrread( file, len )
+char	*file;
+int	*len;
+{
+	FILE	*f;
+	char	*buf;
+	int	size = 8192;
+	int	l;
+
+	if( !( f = fopen( file, "r" ) ) )
+	    return 0;
+
+	buf = (char *)malloc( size );
+	*len = 0;
+
+	while( ( l = fread( buf + *len, 1, size - *len - 1, f ) ) > 0 )
+	    if( ( *len += l ) == size - 1 )
+		buf = (char *)realloc( buf, size *= 2 );
+
+	fclose( f );
+	buf[ *len ] = '\0';
+
+	return buf;
+}
+
+/*
+ * hdrscan_new() - set up a scan of a file with $(HDRSCAN)
+ */
+
+static HDRSCAN *
+hdrscan_new( file )
 char	*file;
-int	rec;
-regexp	*re[];
 {
-    FILE	*f;
-    char	buf[ 1024 ];
-    int		i;
+	HDRSCAN	*scan = (HDRSCAN *)malloc( sizeof( HDRSCAN ) );
+	LIST	*hdrscan = var_get( "HDRSCAN" );
+	LIST	*l;
+
+	memset( (char *)scan, '\0', sizeof( *scan ) );
+	scan->job.func = headers1;
+	scan->file = file;
+
+	/* Get all regular expressions in HDRSCAN */
+
+	for( l = hdrscan; l; l = list_next( l ) )
+	    scan->rec++;
+
+	scan->re = (regexp **)malloc( scan->rec * sizeof( regexp * ) + 1 );
+
+	for( scan->rec = 0; hdrscan; hdrscan = list_next( hdrscan ) )
+	    scan->re[scan->rec++] = hdrscan_re( hdrscan->string );
+
+	return scan;
+}
+
+/*
+ * hdrscan_re() - compile a $(HDRSCAN) pattern, once per run
+ *
+ * HDRSCAN is nearly always the same few patterns, so each is compiled
+ * only the first time it's seen.  A pattern that doesn't compile is
+ * remembered as such, so it is reported only once.
+ */
+
+static regexp *
+hdrscan_re( pattern )
+char	*pattern;
+{
+	struct hdrre hr, *r = &hr;
+
+	if( !hdrres )
+	    hdrres = hashinit( sizeof( struct hdrre ), "hdrscan" );
+
+	r->name = pattern;
+
+	if( hashenter( hdrres, (HASHDATA **)&r ) )
+	{
+	    r->name = newstr( pattern );
+	    r->re = regcomp( pattern );
+	}
+
+	return r->re;
+}
+
+/*
+ * hdrscan_free() - free a scan
+ */
+
+static void
+hdrscan_free( scan )
+HDRSCAN	*scan;
+{
+	free( (char *)scan->re );
+
+	if( scan->found )
+	    free( scan->found );
+
+	free( (char *)scan );
+}
+
+/*
+ * headers1() - using regexp, scan a file for include names
+ *
+ * The whole file is read into one buffer and each line matched where
+ * it lies, NUL-terminated just past its newline for the duration, so
+ * lines are neither copied nor split however long they are.
+ */
+
+static void
+headers1( job )
+TJOB	*job;
+{
+    HDRSCAN	*scan = (HDRSCAN *)job;
+    char	*buf, *line, *end;
+    char	**startp, **endp;
+    regset	*set;
+    char	*s;
+    int		i, l, c;
+    int		len;
 
-    if( !( f = fopen( file, "r" ) ) )
-	return l;
+    if( !( buf = hdrread( scan->file, &len ) ) )
+	return;
 
-    while( fgets( buf, sizeof( buf ), f ) )
+    set = regset_new( scan->re, scan->rec );
+    startp = (char **)malloc( scan->rec * NSUBEXP * sizeof( char * ) + 1 );
+    endp = (char **)malloc( scan->rec * NSUBEXP * sizeof( char * ) + 1 );
+
+    for( line = buf; line < buf + len; *end = c, line = end )
     {
-	for( i = 0; i < rec; i++ )
-	    if( regexec( re[i], buf ) && re[i]->startp[1] )
+	if( end = memchr( line, '\n', buf + len - line ) )
+	    end++;
+	else
+	    end = buf + len;
+
+	c = *end;
+	*end = '\0';
+
+	if( !regset_exec( set, line, startp, endp ) )
+	    continue;
+
+	for( i = 0; i < scan->rec; i++ )
+	    if( startp[ i * NSUBEXP ] && startp[ i * NSUBEXP + 1 ] )
 	{
-	    re[i]->endp[1][0] = '\0';
+	    s = startp[ i * NSUBEXP + 1 ];
+	    l = endp[ i * NSUBEXP + 1 ] - s + 1;
+
+	    /* Now that lines can be long, so can names: too long for */
+	    /* a file name is too long for anything jam does with them. */
 
-	    if( DEBUG_HEADER )
-		printf( "header found: %s\n", re[i]->startp[1] );
+	    if( l > MAXJPATH )
+		continue;
 
-	    l = list_new( l, newstr( re[i]->startp[1] ) );
+	    if( scan->len + l > scan->size )
+	    {
+		scan->size = scan->size * 2 + l + 256;
+		scan->found = scan->found
+		    ? (char *)realloc( scan->found, scan->size )
+		    : (char *)malloc( scan->size );
+	    }
+
+	    memcpy( scan->found + scan->len, s, l - 1 );
+	    scan->found[ scan->len + l - 1 ] = '\0';
+	    scan->len += l;
 	}
     }
 
-    fclose( f );
-
-    return l;
+    free( (char *)startp );
+    free( (char *)endp );
+    free( buf );
+    regset_free( set );
 }
 
 void
@@ -9,3 +9,4 @@
  */
 
 void headers();
+void headers_prefetch();
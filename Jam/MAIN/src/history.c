@@ -0,0 +1,244 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "variable.h"
+# include "hash.h"
+# include "newstr.h"
+# include "history.h"
+
+# ifdef unix
+# include <sys/time.h>
+# endif
+
+/*
+ * history.c - remember how long targets took to update
+ *
+ * If $(JAMHISTORY) names a file, it holds how many milliseconds the
+ * actions updating each target took the last time they ran.  The file
+ * starts with a version line, and then has one line per target:
+ *
+ *	<ms> <age> <target name>
+ *
+ * make1() uses these to run the targets on the longest path to the
+ * top first.  <age> counts the runs since the entry was last used, as
+ * in the header cache (see hcache.c), so that targets renamed or gone
+ * don't stay in the file forever.
+ *
+ * External routines:
+ *
+ *	hist_load() - read the history file named by $(JAMHISTORY)
+ *	hist_get() - how many ms a target took last time, or -1
+ *	hist_set() - note how many ms a target took this time
+ *	hist_save() - write the history file back, if anything changed
+ *	hist_now() - a clock for timing actions, in ms
+ */
+
+# define HIST_VERSION "# jam history 1\n"
+# define HIST_MAXAGE 100
+
+typedef struct _hist HIST;
+
+struct _hist {
+	char	*name;
+	int	ms;
+	int	age;		/* runs since last used */
+	HIST	*next;		/* for hist_save() */
+} ;
+
+static struct hash *histhash = 0;
+static HIST *histlist = 0;
+static char *histfile = 0;
+static int histdirty = 0;
+
+/*
+ * hist_load() - read the history file named by $(JAMHISTORY)
+ */
+
+void
+hist_load()
+{
+	LIST	*l = var_get( "JAMHISTORY" );
+	FILE	*f;
+	char	buf[ MAXJPATH + 32 ];
+	HIST	hist, *h = &hist;
+	int	ms, age, n;
+
+	if( !l || histhash )
+	    return;
+
+	histfile = l->string;
+	histhash = hashinit( sizeof( HIST ), "history" );
+
+	if( !( f = fopen( histfile, "r" ) ) )
+	    return;
+
+	if( !fgets( buf, sizeof( buf ), f ) || strcmp( buf, HIST_VERSION ) )
+	{
+	    printf( "warning: ignoring history file %s\n", histfile );
+	    fclose( f );
+	    return;
+	}
+
+	while( fgets( buf, sizeof( buf ), f ) && strchr( buf, '\n' ) )
+	{
+	    if( sscanf( buf, "%d %d %n", &ms, &age, &n ) < 2 || !buf[n] )
+		continue;
+
+	    buf[ strlen( buf ) - 1 ] = '\0';
+
+	    hist_set( buf + n, ms );
+
+	    h = &hist;
+	    h->name = buf + n;
+
+	    if( hashcheck( histhash, (HASHDATA **)&h ) )
+		h->age = age;
+	}
+
+	fclose( f );
+
+	histdirty = 0;
+
+	if( DEBUG_MAKEPROG )
+	    printf( "read history from %s\n", histfile );
+}
+
+/*
+ * hist_get() - how many ms a target took last time, or -1
+ */
+
+int
+hist_get( name )
+char	*name;
+{
+	HIST	hist, *h = &hist;
+
+	h->name = name;
+
+	if( !histhash || !hashcheck( histhash, (HASHDATA **)&h ) )
+	    return -1;
+
+	if( h->age > 1 )
+	    histdirty = 1;
+
+	h->age = 0;
+
+	return h->ms;
+}
+
+/*
+ * hist_set() - note how many ms a target took this time
+ */
+
+void
+hist_set( name, ms )
+char	*name;
+int	ms;
+{
+	HIST	hist, *h = &hist;
+
+	if( !histhash )
+	    return;
+
+	h->name = name;
+
+	if( hashenter( histhash, (HASHDATA **)&h ) )
+	{
+	    h->name = newstr( name );
+	    h->next = histlist;
+	    histlist = h;
+	}
+
+	h->ms = ms;
+	h->age = 0;
+	histdirty = 1;
+}
+
+/*
+ * hist_save() - write the history file back, if anything changed
+ *
+ * Entries not used in HIST_MAXAGE runs are dropped.  It's written to a temporary file that is renamed into place,
+ * so an interrupted jam doesn't lose the history.
+ */
+
+void
+hist_save()
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	HIST	*h;
+
+	if( !histhash )
+	    return;
+
+	/* Entries not used this run have aged; those used again */
+	/* go back to age 1. */
+
+	for( h = histlist; h; h = h->next )
+	    if( h->age )
+		histdirty = 1;
+
+	if( !histdirty )
+	    return;
+
+	if( strlen( histfile ) + 5 > MAXJPATH )
+	    return;
+
+	sprintf( tmp, "%s.new", histfile );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "can't write history file %s\n", tmp );
+	    return;
+	}
+
+	fputs( HIST_VERSION, f );
+
+	for( h = histlist; h; h = h->next )
+	{
+	    if( h->age >= HIST_MAXAGE || strchr( h->name, '\n' ) )
+		continue;
+
+	    fprintf( f, "%d %d %s\n", h->ms, h->age + 1, h->name );
+	}
+
+	if( fclose( f ) || rename( tmp, histfile ) )
+	    printf( "can't write history file %s\n", histfile );
+
+	histdirty = 0;
+}
+
+/*
+ * hist_now() - a clock for timing actions, in ms
+ *
+ * Counts from the first call, so it fits in an int.
+ */
+
+int
+hist_now()
+{
+# ifdef unix
+	static struct timeval t0;
+	struct timeval t;
+
+	gettimeofday( &t, 0 );
+
+	if( !t0.tv_sec )
+	    t0 = t;
+
+	return ( t.tv_sec - t0.tv_sec ) * 1000 + 
+	       ( t.tv_usec - t0.tv_usec ) / 1000;
+# else
+	static time_t t0;
+
+	if( !t0 )
+	    t0 = time( (time_t *)0 );
+
+	return ( time( (time_t *)0 ) - t0 ) * 1000;
+# endif
+}
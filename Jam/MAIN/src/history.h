@@ -0,0 +1,15 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * history.h - remember how long targets took to update
+ */
+
+void hist_load();
+int hist_get();
+void hist_set();
+void hist_save();
+int hist_now();
@@ -15,6 +15,7 @@
 # include "jam.h"
 # include "option.h"
 # include "make.h"
+# include "execcmd.h"
 # ifdef FATFS
 # include "patchlev.h"
 # else
@@ -30,12 +31,23 @@
 # include "rules.h"
 # include "newstr.h"
 # include "scan.h"
+# include "trace.h"
+# include "hcache.h"
+# include "dcache.h"
+# include "sigdb.h"
+# include "acache.h"
 # ifdef FATFS
 # include "timestam.h"
 # else
 # include "timestamp.h"
 # endif
 
+/* -j0 counts the CPUs */
+
+# ifdef unix
+# include <unistd.h>
+# endif
+
 /* Macintosh is "special" */
 
 # ifdef macintosh
@@ -89,20 +101,25 @@
  *
  * Roughly, the modules are:
  *
+ *	acache.c - reuse what earlier runs of the same actions produced
  *	command.c - maintain lists of commands
  *	compile.c - compile parsed jam statements
+ *	dcache.c - remember what directory scans found, across runs
  *	execunix.c - execute a shell script on UNIX
  *	execvms.c - execute a shell script, ala VMS
  *	expand.c - expand a buffer, given variable values
  *	fileunix.c - manipulate file names and scan directories on UNIX
  *	filevms.c - manipulate file names and scan directories on VMS
  *	hash.c - simple in-memory hashing routines 
+ *	hcache.c - remember what header scans found, across runs
  *	headers.c - handle #includes in source files
+ *	history.c - remember how long targets took to update
  *	jambase.c - compilable copy of Jambase
  *	jamgram.y - jam grammar
  *	lists.c - maintain lists of strings
  *	make.c - bring a target up to date, once rules are in place
  *	make1.c - execute command to bring targets up to date
+ *	md5.c - the MD5 message digest
  *	newstr.c - string manipulation routines
  *	option.c - command line option processing
  *	parse.c - make and destroy parse trees as driven by the parser
@@ -110,7 +127,10 @@
  *	rules.c - access to RULEs, TARGETs, and ACTIONs
  *	scan.c - the jam yacc scanner
  *	search.c - find a target along $(SEARCH) or $(LOCATE) 
+ *	sigdb.c - judge targets by the content of their inputs
  *	timestamp.c - get the timestamp of a file or archive member
+ *	tpool.c - a pool of threads to run jobs off the main thread
+ *	trace.c - record a build's timeline as Chrome trace events
  *	variable.c - handle jam multi-element variables
  *
  * 05/04/94 (seiwald) - async multiprocess (-j) support
@@ -121,6 +141,9 @@
 struct globs globs = {
 	0,			/* noexec */
 	1,			/* jobs */
+	0.0,			/* load */
+	0,			/* memfree */
+	0,			/* pipeline */
 # ifdef macintosh
 	{ 0, 0 }		/* debug - suppress tracing output */
 # else
@@ -160,17 +183,22 @@ char	**argv;
 
 	argc--, argv++;
 
-	if( ( n = getoptions( argc, argv, "d:j:f:s:t:anv", optv ) ) < 0 )
+	if( ( n = getoptions( argc, argv, "d:j:f:l:m:s:t:T:anpv", optv ) ) < 0 )
 	{
 	    printf( "\nusage: jam [ options ] targets...\n\n" );
 
             printf( "-a      Build all targets, even if they are current.\n" );
-            printf( "-dx     Set the debug level to x (0-9).\n" );
+            printf( "-dx     Set the debug level to x (0-10).\n" );
             printf( "-fx     Read x instead of Jambase.\n" );
             printf( "-jx     Run up to x shell commands concurrently.\n" );
+            printf( "        -j0 runs one per online CPU.\n" );
+            printf( "-lx     Start no new commands at load average x.\n" );
+            printf( "-mx     Start no new commands with under x MB free.\n" );
             printf( "-n      Don't actually execute the updating actions.\n" );
+            printf( "-p      Start updating targets before all are bound.\n" );
 	    printf( "-sx=y   Set variable x=y, overriding environment.\n" );
             printf( "-tx     Rebuild x, even if it is up-to-date.\n" );
+            printf( "-Tx     Write a Chrome trace of the build to x.\n" );
             printf( "-v      Print the version of jam and exit.\n\n" );
 
 	    exit( EXITBAD );
@@ -197,9 +225,34 @@ char	**argv;
 	if( ( s = getoptval( optv, 'a', 0 ) ) )
 	    anyhow++;
 
+	if( ( s = getoptval( optv, 'p', 0 ) ) )
+	    globs.pipeline++;
+
 	if( ( s = getoptval( optv, 'j', 0 ) ) )
 	    globs.jobs = atoi( s );
 
+	if( ( s = getoptval( optv, 'l', 0 ) ) )
+	    globs.load = atof( s );
+
+	if( ( s = getoptval( optv, 'm', 0 ) ) )
+	    globs.memfree = atoi( s );
+
+	/* -j0 means one job per online CPU */
+
+	if( globs.jobs <= 0 )
+	{
+# ifdef _SC_NPROCESSORS_ONLN
+	    globs.jobs = sysconf( _SC_NPROCESSORS_ONLN );
+# endif
+	    if( globs.jobs <= 0 )
+		globs.jobs = 1;
+	}
+
+	/* -T starts the trace before anything worth tracing */
+
+	if( ( s = getoptval( optv, 'T', 0 ) ) )
+	    trace_open( s );
+
 	/* Turn on/off debugging */
 
 	for( n = 0; s = getoptval( optv, 'd', n ); n++ )
@@ -229,6 +282,13 @@ char	**argv;
 		globs.debug[i--] = 1;
 	}
 
+	/* Size the job tables, and join or start a jobserver, which */
+	/* can change globs.jobs: before binding, which looks ahead */
+	/* with -j. */
+
+	if( !globs.noexec )
+	    execinit();
+
 	/* Set JAMDATE first */
 
 	{
@@ -266,12 +326,16 @@ char	**argv;
 
 	/* Parse ruleset */
 
+	trace_begin( "parse" );
+
 	for( n = 0; s = getoptval( optv, 'f', n ); n++ )
 	    parse_file( s );
 
 	if( !n )
 	    parse_file( "+" );
 
+	trace_end( "parse" );
+
 	status = yyanyerrors();
 
 	/* Manually touch -t targets */
@@ -286,6 +350,13 @@ char	**argv;
 	else
 	    status |= make( argc, argv, anyhow );
 
+	hcache_done();
+	dcache_done();
+	sigdb_done();
+	acache_done();
+	trace_close();
+	compile_profile();
+
 	/* Widely scattered cleanup */
 
 	var_done();
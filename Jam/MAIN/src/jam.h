@@ -276,18 +276,18 @@ int unlink( char *f ); 	/* In filevms.c */
 # define MAXSYM	1024	/* longest symbol in the environment */
 # define MAXJPATH 1024	/* longest filename */
 
-# define MAXJOBS 64	/* silently enforce -j limit */
 # define MAXARGC 32	/* words in $(JAMSHELL) */
 
-# define CMDBUF 10240	/* size of command blocks */
-
 /* Jam private definitions below. */
 
-# define DEBUG_MAX	10
+# define DEBUG_MAX	11
 
 struct globs {
 	int	noexec;
 	int	jobs;
+	double	load;		/* -l: no new jobs at this load average */
+	int	memfree;	/* -m: no new jobs below this many MB free */
+	int	pipeline;	/* -p: update targets while still binding */
 	char	debug[DEBUG_MAX];
 } ;
 
@@ -315,3 +315,5 @@ extern struct globs globs;
 # define DEBUG_SCAN	( globs.debug[ 9 ] )	/* show scanner tokens */
 # define DEBUG_MEM	( globs.debug[ 9 ] )	/* show memory use */
 
+# define DEBUG_PROFILE	( globs.debug[ 10 ] )	/* show rule profile */
+
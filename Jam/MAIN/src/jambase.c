@@ -325,6 +325,11 @@ char *jambase[] = {
 "{\n",
 "CcMv $(<) : $(>) ;\n",
 "}\n",
+"if $(DEPFILES) && $(UNIX) && ! $(RELOCATE)\n",
+"{\n",
+"CCFLAGS on $(<) += -MD ;\n",
+"DepFile $(<) : $(>) ;\n",
+"}\n",
 "_h = $(SEARCH_SOURCE) $(HDRS) $(SUBDIRHDRS) ;\n",
 "if $(VMS) && $(_h)\n",
 "{\n",
@@ -350,6 +355,11 @@ char *jambase[] = {
 "{\n",
 "CcMv $(<) : $(>) ;\n",
 "}\n",
+"if $(DEPFILES) && $(UNIX) && ! $(RELOCATE)\n",
+"{\n",
+"C++FLAGS on $(<) += -MD ;\n",
+"DepFile $(<) : $(>) ;\n",
+"}\n",
 "_h = $(SEARCH_SOURCE) $(HDRS) $(SUBDIRHDRS) ;\n",
 "if $(VMS) && $(_h)\n",
 "{\n",
@@ -366,6 +376,14 @@ char *jambase[] = {
 "MACINC on $(<) = \\\"$(_j)\\\" ;\n",
 "}\n",
 "}\n",
+"rule DepFile\n",
+"{\n",
+"local _d ;\n",
+"_d = $(<:S=.d) ;\n",
+"DEPFILE on $(>) = $(_d) ;\n",
+"LOCATE on $(_d) = $(LOCATE_TARGET) ;\n",
+"Clean clean : $(_d) ;\n",
+"}\n",
 "rule File\n",
 "{\n",
 "DEPENDS files : $(<) ;\n",
@@ -21,6 +21,7 @@
  *
  * Internal routines:
  * 	make0() - bind and scan everything to make a TARGET
+ *	make0prefetch() - start the header scans of targets make0() will reach
  *
  * 12/26/93 (seiwald) - allow NOTIME targets to be expanded via $(<), $(>)
  * 01/04/94 (seiwald) - print all targets, bounded, when tracing commands
@@ -46,9 +47,12 @@
 # include "newstr.h"
 # include "make.h"
 # include "headers.h"
+# include "sigdb.h"
 # include "command.h"
+# include "trace.h"
 
 static void make0();
+static void make0prefetch();
 
 # ifndef max
 # define max( a,b ) ((a)>(b)?(a):(b))
@@ -104,6 +108,8 @@ int	anyhow;
 
 	memset( (char *)counts, 0, sizeof( *counts ) );
 
+	trace_begin( "bind" );
+
 	for( i = 0; i < n_targets; i++ )
 	{
 	    TARGET *t = bindtarget( targets[i] );
@@ -111,6 +117,8 @@ int	anyhow;
 	    make0( t, T_BIND_UNBOUND, (time_t)0, 0, counts, anyhow );
 	}
 
+	trace_end( "bind" );
+
 	if( DEBUG_MAKE )
 	{
 	    if( counts->targets )
@@ -127,8 +135,12 @@ int	anyhow;
 
 	status = counts->cantfind || counts->cantmake;
 
+	trace_begin( "update" );
+
 	for( i = 0; i < n_targets; i++ )
-	    status |= make1( bindtarget( targets[i] ) );
+	    status |= make1( bindtarget( targets[i] ), anyhow );
+
+	trace_end( "update" );
 
 	return status;
 }
@@ -246,6 +258,8 @@ int	anyhow;		/* forcibly touch all (real) targets */
 	leaf = 0;
 	fate = T_FATE_STABLE;
 
+	make0prefetch( t->deps[ T_DEPS_DEPENDS ] );
+
 	for( c = t->deps[ T_DEPS_DEPENDS ]; c; c = c->next )
 	{
 	    make0( c->target, t->binding, t->time, depth + 1, counts, anyhow );
@@ -303,7 +317,8 @@ int	anyhow;		/* forcibly touch all (real) targets */
 	{
 	    fate = T_FATE_MISSING;
 	}
-	else if( t->binding == T_BIND_EXISTS && last > t->time )
+	else if( t->binding == T_BIND_EXISTS && last > t->time &&
+		!( t->actions && sigdb_check( t ) ) )
 	{
 	    fate = T_FATE_OUTDATED;
 	}
@@ -336,14 +351,22 @@ int	anyhow;		/* forcibly touch all (real) targets */
 	    fate = T_FATE_STABLE;
 	}
 
+	/* With $(SIGFILE), start off the signature of what's already */
+	/* up to date, so touching its inputs won't rebuild it. */
+
+	if( fate < T_FATE_SPOIL && t->actions &&
+		t->binding == T_BIND_EXISTS &&
+		!globs.noexec && !sigdb_known( t ) )
+	    sigdb_set( t );
+
 	/* Step 3c: handle missing files */
 	/* If it's missing and there are no actions to create it, boom. */
 	/* If we can't make a target we don't care about, 'sokay */
 	/* We could insist that there are updating actions for all missing */
 	/* files, but if they have dependents we just pretend it's NOTFILE. */
 
-	if( fate == T_FATE_MISSING && 
-		!t->actions && 
+	if( fate == T_FATE_MISSING &&
+		!t->actions &&
 		!t->deps[ T_DEPS_DEPENDS ] )
 	{
 	    if( t->flags & T_FLAG_NOCARE )
@@ -375,6 +398,8 @@ int	anyhow;		/* forcibly touch all (real) targets */
 	hleaf = 0;
 	hfate = T_FATE_STABLE;
 
+	make0prefetch( t->deps[ T_DEPS_INCLUDES ] );
+
 	for( c = t->deps[ T_DEPS_INCLUDES ]; c; c = c->next )
 	{
 	    make0( c->target, pbinding, ptime, depth + 1, counts, anyhow );
@@ -417,5 +442,73 @@ int	anyhow;		/* forcibly touch all (real) targets */
 	    printf( "made%s\t%s\t%s%s\n", 
 		flag, target_fate[ t->fate ], 
 		spaces( depth ), t->name );
+
+	/* 
+	 * Step 6: with -p, start updating the target now that it and 
+	 * its dependents are bound, rather than after the whole graph.
+	 */
+
+	if( globs.pipeline )
+	    make1early( t, anyhow );
 }
 
+
+/*
+ * make0prefetch() - start the header scans of targets make0() will reach
+ *
+ * With -j, make0() looks up a target's dependents (or headers) here, 
+ * before recursing into any of them, so the scans of all of them can 
+ * run on the thread pool while make0() works through them one by one.
+ * They are looked up just as make0() would, under their settings, but
+ * not bound: the HDRRULE of one can still set SEARCH on the next, so
+ * make0() binds each only when it gets to it, and headers() checks
+ * that the scan is of the file it was bound to.  The directories
+ * they'd be bound in are handed to the pool first, so that those are
+ * scanned together rather than one by one.
+ */
+
+static void
+make0prefetch( c )
+TARGETS	*c;
+{
+	TARGETS	*c0 = c;
+	TARGET	*t;
+	char	*boundname;
+	time_t	time;
+
+	if( globs.jobs < 2 )
+	    return;
+
+	for( ; c; c = c->next )
+	{
+	    t = c->target;
+
+	    if( t->fate != T_FATE_INIT || 
+		t->binding != T_BIND_UNBOUND ||
+		t->flags & T_FLAG_NOTFILE )
+		    continue;
+
+	    pushsettings( t->settings );
+	    search_prefetch( t->name );
+	    popsettings( t->settings );
+	}
+
+	for( c = c0; c; c = c->next )
+	{
+	    t = c->target;
+
+	    if( t->fate != T_FATE_INIT || 
+		t->binding != T_BIND_UNBOUND ||
+		t->flags & T_FLAG_NOTFILE )
+		    continue;
+
+	    pushsettings( t->settings );
+
+	    boundname = search( t->name, &time );
+
+	    if( time )
+		headers_prefetch( t, boundname, time );
+
+	    popsettings( t->settings );
+	}
+}
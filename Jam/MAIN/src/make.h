@@ -10,3 +10,4 @@
 
 int make();
 int make1();
+void make1early();
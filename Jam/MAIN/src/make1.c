@@ -8,23 +8,46 @@
  * make1.c - execute command to bring targets up to date
  *
  * This module contains make1(), the entry point called by make() to 
- * recursively decend the dependency graph executing update actions as
- * marked by make0().
+ * decend the dependency graph executing update actions as marked by
+ * make0().  Rather than recursing, the steps of the descent are kept
+ * on a work stack that make1run() processes until it's empty.
  *
  * External routines:
  *
  *	make1() - execute commands to update a TARGET and all its dependents
+ *	make1early() - start updating a TARGET while make0() binds the rest
  *
- * Internal routines, the recursive/asynchronous command executors:
+ * Internal routines, the iterative/asynchronous command executors:
  *
- *	make1a() - recursively traverse target tree, calling make1b()
+ *	make1run() - process the work stack until it's empty
+ *	make1state() - push a step onto the work stack
+ *	make1a() - traverse target tree, pushing make1a() for dependents
+ *	make1atail() - dependents visited, now call make1b()
  *	make1b() - dependents of target built, now build target with make1c()
- *	make1c() - launch target's next command, call make1b() when done
+ *	make1c() - queue target's next command, push make1b() when done
  *	make1d() - handle command execution completion and call back make1c()
  *
+ * Internal routines, early cutoff:
+ *
+ *	make1restat() - did updating a target leave its file unchanged?
+ *	make1cutoff() - did all a target's updated dependents come out unchanged?
+ *	make1last() - find the latest time among a target's dependents
+ *	make1mark() - note the content of an action's targets before it runs
+ *
+ * Internal routines, the scheduler:
+ *
+ *	make1prioritize() - rank targets by the longest path to the top
+ *	make1dispatch() - start ready targets' commands, highest rank first
+ *	make1exec() - start a target's next command
+ *	make1push() - add a target to the ready queue
+ *	make1pop() - take the highest ranked target off the ready queue
+ *
  * Internal support routines:
  *
+ *	make1cost() - guess how long a target's commands will take
+ *	make1banner() - show the action being run (and its text, with -d2)
  *	make1cmds() - turn ACTIONS into CMDs, grouping, splitting, etc
+ *	make1pool() - find a job pool, setting them up from $(JOBPOOLS)
  *	make1chunk() - compute number of source that can fit on cmd line
  *	make1list() - turn a list of targets into a LIST, for $(<) and $(>)
  * 	make1settings() - for vars that get bound values, build up replacement lists
@@ -53,13 +76,40 @@
 # include "make.h"
 # include "command.h"
 # include "execcmd.h"
-
+# include "hash.h"
+# include "history.h"
+# include "sigdb.h"
+# include "acache.h"
+# include "timestamp.h"
+# include "filesys.h"
+# include "trace.h"
+
+# define max( a,b ) ((a)>(b)?(a):(b))
+
+static void make1run();
+static void make1state();
 static void make1a();
+static void make1atail();
 static void make1b();
 static void make1c();
 static void make1d();
 
+static int make1restat();
+static int make1cutoff();
+static int make1last();
+static void make1mark();
+
+static void make1prioritize();
+static void make1dispatch();
+static void make1exec();
+static void make1push();
+static TARGET *make1pop();
+
+static int make1cost();
+
+static void make1banner();
 static CMD *make1cmds();
+static struct jobpool *make1pool();
 static int make1chunk();
 static LIST *make1list();
 static SETTINGS *make1settings();
@@ -72,8 +122,100 @@ static struct {
 	int	skipped;
 	int	total;
 	int	made;
+	int	unchanged;
+	int	cached;
 } counts[1] ;
 
+/*
+ * Job pools: $(JOBPOOLS) = name=limit ... caps the number of commands
+ * running at once for targets that have $(JOBPOOL) set to name.  A
+ * command that would exceed its pool's limit waits on the pool's
+ * queue until one of the pool's commands completes.
+ */
+
+typedef struct _jobwait JOBWAIT;
+
+struct _jobwait {
+	JOBWAIT	*next;
+	TARGET	*t;
+} ;
+
+struct jobpool {
+	char	*name;
+	int	limit;
+	int	running;
+	JOBWAIT	*head;		/* targets waiting on the pool */
+	JOBWAIT	*tail;
+} ;
+
+static struct hash *jobpools = 0;
+
+/*
+ * The work stack: each step is a call to make1a(), make1atail() or
+ * make1b(), pushed rather than made directly so that neither deep
+ * dependency graphs nor long chains of completions recurse on the
+ * C stack.  Asynccnt on each target counts the dependents it's
+ * waiting on.
+ */
+
+typedef struct _state STATE;
+
+struct _state {
+	TARGET	*t;
+	TARGET	*parent;
+	int	curstate;
+
+# define	T_STATE_MAKE1A		0	/* make1a( t, parent ) */
+# define	T_STATE_MAKE1ATAIL	1	/* make1atail( t ) */
+# define	T_STATE_MAKE1B		2	/* make1b( t ) */
+} ;
+
+static STATE *states = 0;
+static int nstates = 0;
+static int maxstates = 0;
+static int stepping = 0;
+
+/*
+ * The ready queue: targets whose next command can run wait here, and
+ * make1dispatch() starts them as job slots free up.  Targets on the
+ * longest path (by the durations in $(JAMHISTORY)) to the top go
+ * first, so the build's tail isn't one long command run alone.
+ *
+ * Nothing is started until make1a() has seen the whole graph and
+ * make1prioritize() has ranked the targets.
+ */
+
+struct ready {
+	TARGET	*t;
+	int	seq;		/* first come, first served among equals */
+} ;
+
+static struct ready *ready = 0;		/* a heap */
+static int nready = 0;
+static int maxready = 0;
+static int readyseq = 0;
+
+static TARGET **order = 0;		/* make1a()'s postorder */
+static int norder = 0;
+static int maxorder = 0;
+
+/*
+ * Early cutoff: make0() decides a target must be updated if anything
+ * it depends on is to be updated, not knowing whether that will come
+ * out any different.  When a target's commands leave its file as it
+ * was -- by its time, if $(RESTAT) is set on it, or by its content,
+ * if $(SIGFILE) is set -- its fate is set back to stable, and each
+ * target waiting on it gets its own fate decided again, from the
+ * times (and signatures) its dependents now have.
+ */
+
+static int anyhow = 0;			/* -a: no cutoff */
+static time_t began = 0;		/* files older can be restat'ed */
+
+static int prioritized = 0;
+static int early = 0;			/* make1early() starts unranked */
+static int running = 0;			/* commands started */
+
 /*
  * make1() - execute commands to update a TARGET and all its dependents
  */
@@ -81,20 +223,50 @@ static struct {
 static int intr = 0;
 
 int
-make1( t )
-TARGET *t;
+make1( t, all )
+TARGET	*t;
+int	all;
 {
-	memset( (char *)counts, 0, sizeof( *counts ) );
+	int	status;
+
+	anyhow = all;
+
+	/* Each target's graph is ranked before its commands start */
+	/* (unless make1early() has been starting them all along). */
 
-	/* Recursively make the target and its dependents */
+	if( !early )
+	    prioritized = 0;
 
-	make1a( t, (TARGET *)0 );
+	if( !began )
+	    began = time( (time_t *)0 );
+
+	/* Main() has already sized the job tables and settled */
+	/* the jobserver with execinit(). */
+
+	if( !globs.noexec )
+	    hist_load();
+
+	/* Make the target and its dependents */
+
+	make1state( t, (TARGET *)0, T_STATE_MAKE1A );
+	make1run();
+
+	/* With the whole graph seen, rank the targets and start */
+	/* running their commands. */
+
+	if( !globs.noexec )
+	{
+	    make1prioritize();
+	    make1run();
+	}
 
 	/* Wait for any outstanding commands to finish running. */
 
 	while( execwait() )
 	    ;
 
+	hist_save();
+
 	/* Talk about it */
 
 	if( DEBUG_MAKE && counts->failed )
@@ -106,11 +278,121 @@ TARGET *t;
 	if( DEBUG_MAKE && counts->made )
 	    printf( "...updated %d target(s)...\n", counts->made );
 
-	return counts->total != counts->made;
+	if( DEBUG_MAKE && counts->cached )
+	    printf( "...took %d target(s) from the action cache...\n",
+		counts->cached );
+
+	if( DEBUG_MAKE && counts->unchanged )
+	    printf( "...kept %d target(s) whose dependents came out unchanged...\n",
+		counts->unchanged );
+
+	/* The counts start over for the next target, but include */
+	/* anything make1early() did before make1() was called. */
+
+	status = counts->total != counts->made;
+
+	memset( (char *)counts, 0, sizeof( *counts ) );
+
+	return status;
+}
+
+/*
+ * make1early() - start updating a TARGET while make0() binds the rest
+ *
+ * With -p, make0() calls this as soon as a target and its dependents
+ * are bound.  Their commands start in the order they become ready:
+ * they are only ranked once make1() has seen the whole graph.
+ */
+
+void
+make1early( t, all )
+TARGET	*t;
+int	all;
+{
+	anyhow = all;
+
+	if( !began )
+	    began = time( (time_t *)0 );
+
+	if( !globs.noexec )
+	    hist_load();
+
+	early = 1;
+
+	make1state( t, (TARGET *)0, T_STATE_MAKE1A );
+	make1run();
+
+	/* Keep the commands going: drive the completions of any */
+	/* that finished, which starts the next ones. */
+
+	if( !globs.noexec )
+	    execcheck();
+}
+
+/*
+ * make1run() - process the work stack until it's empty
+ *
+ * Then start what commands we can, which may push more work.
+ * Commands finishing while make1exec() waits call make1d() and so
+ * back here: the outermost call does the work.
+ */
+
+static void
+make1run()
+{
+	STATE	s;
+
+	if( stepping )
+	    return;
+
+	stepping = 1;
+
+	do
+	{
+	    while( nstates )
+	    {
+		s = states[ --nstates ];
+
+		switch( s.curstate )
+		{
+		case T_STATE_MAKE1A:	 make1a( s.t, s.parent ); break;
+		case T_STATE_MAKE1ATAIL: make1atail( s.t ); break;
+		case T_STATE_MAKE1B:	 make1b( s.t ); break;
+		}
+	    }
+
+	    make1dispatch();
+	}
+	while( nstates );
+
+	stepping = 0;
+}
+
+/*
+ * make1state() - push a step onto the work stack
+ */
+
+static void
+make1state( t, parent, curstate )
+TARGET	*t;
+TARGET	*parent;
+int	curstate;
+{
+	if( nstates == maxstates )
+	{
+	    maxstates = maxstates ? maxstates * 2 : 256;
+	    states = (STATE *)realloc( (char *)states, 
+				maxstates * sizeof( STATE ) );
+	}
+
+	states[ nstates ].t = t;
+	states[ nstates ].parent = parent;
+	states[ nstates ].curstate = curstate;
+	nstates++;
 }
 
 /*
- * make1a() - recursively traverse target tree, calling make1b()
+ * make1a() - traverse target tree, pushing make1a() for dependents
  */
 
 static void
@@ -119,7 +401,13 @@ TARGET	*t;
 TARGET	*parent;
 {
 	TARGETS	*c;
-	int i;
+	int	i, base;
+
+	/* With -p, a target that make0() is still binding (we got */
+	/* to it through a circular dependency) is left for later. */
+
+	if( t->fate == T_FATE_MAKING )
+	    return;
 
 	/* If the parent is the first to try to build this target */
 	/* or this target is in the make1c() quagmire, arrange for the */
@@ -141,22 +429,58 @@ TARGET	*parent;
 	/* Asynccnt counts the dependents preventing this target from */
 	/* proceeding to make1b() for actual building.  We start off with */
 	/* a count of 1 to prevent anything from happening until we can */
-	/* call all dependents.  This 1 is accounted for when we call */
-	/* make1b() ourselves, below. */
+	/* call all dependents.  This 1 is accounted for when */
+	/* make1atail() calls make1b(). */
 
 	t->asynccnt = 1;
 
-	/* Recurse on our dependents, manipulating progress to guard */
-	/* against circular dependency. */
+	/* Visit our dependents, then make1atail(), manipulating */
+	/* progress to guard against circular dependency.  The stack */
+	/* is last in, first out: push make1atail() first, and the */
+	/* dependents in reverse, so they're visited in order. */
 
 	t->progress = T_MAKE_ONSTACK;
 
+	make1state( t, (TARGET *)0, T_STATE_MAKE1ATAIL );
+
+	base = nstates;
+
 	for( i = T_DEPS_DEPENDS; i <= T_DEPS_INCLUDES; i++ )
 	    for( c = t->deps[i]; c && !intr; c = c->next )
-		make1a( c->target, t );
+		make1state( c->target, t, T_STATE_MAKE1A );
 
+	for( i = nstates - 1; base < i; base++, i-- )
+	{
+	    STATE s = states[ base ];
+	    states[ base ] = states[i];
+	    states[i] = s;
+	}
+}
+
+/*
+ * make1atail() - dependents visited, now call make1b()
+ */
+
+static void
+make1atail( t )
+TARGET	*t;
+{
 	t->progress = T_MAKE_ACTIVE;
 
+	/* Remember the order for make1prioritize(): dependents first. */
+
+	if( !globs.noexec )
+	{
+	    if( norder == maxorder )
+	    {
+		maxorder = maxorder ? maxorder * 2 : 256;
+		order = (TARGET **)realloc( (char *)order, 
+				maxorder * sizeof( TARGET * ) );
+	    }
+
+	    order[ norder++ ] = t;
+	}
+
 	/* Now that all dependents have bumped asynccnt, we now allow */
 	/* decrement our reference to asynccnt. */ 
 
@@ -172,11 +496,12 @@ make1b( t )
 TARGET	*t;
 {
 	TARGETS	*c;
+	ACTIONS	*a;
 	int 	i;
 	char 	*failed = "dependents";
 
 	/* If any dependents are still outstanding, wait until they */
-	/* call make1b() to signal their completion. */
+	/* push make1b() to signal their completion. */
 
 	if( --t->asynccnt )
 	    return;
@@ -202,6 +527,23 @@ TARGET	*t;
 	    printf( "...skipped %s for lack of %s...\n", t->name, failed );
 	}
 
+	/* If what made this target out of date came out unchanged, */
+	/* there's nothing to do after all. */
+
+	if( t->status == EXEC_CMD_OK &&
+	    t->fate == T_FATE_UPDATE &&
+	    !globs.noexec &&
+	    make1cutoff( t ) )
+	{
+	    if( t->actions )
+		++counts->unchanged;
+
+	    if( DEBUG_MAKEPROG )
+		printf( "...dependents of %s unchanged...\n", t->name );
+
+	    t->fate = T_FATE_STABLE;
+	}
+
 	if( t->status == EXEC_CMD_OK )
 	    switch( t->fate )
 	{
@@ -236,11 +578,23 @@ TARGET	*t;
 		if( DEBUG_MAKE && !( ++counts->total % 100 ) )
 		    printf( "...on %dth target...\n", counts->total );
 
+		/* If its actions were already run for another of their */
+		/* targets, it can't be told whether they changed it. */
+
+		for( a = t->actions; a; a = a->next )
+		    if( a->action->rule->actions && a->action->running )
+			t->flags |= T_FLAG_SHARED;
+
 		pushsettings( t->settings );
 		t->cmds = (char *)make1cmds( t->actions );
 		popsettings( t->settings );
 
 		t->progress = T_MAKE_RUNNING;
+
+		/* With $(ACTIONCACHE), sum up its command. */
+
+		if( !globs.noexec && t->cmds )
+		    acache_key( t, (CMD *)t->cmds );
 	    }
 
 	    break;
@@ -256,7 +610,7 @@ TARGET	*t;
 }
 
 /*
- * make1c() - launch target's next command, call make1b() when done
+ * make1c() - queue target's next command, push make1b() when done
  */
 
 static void
@@ -273,27 +627,19 @@ TARGET	*t;
 	/* from all the actions then report our completion to all the */
 	/* parents. */
 
+	/* Commands really run go through the ready queue, to be */
+	/* started by make1exec() when their turn comes. */
+
 	if( cmd && t->status == EXEC_CMD_OK )
 	{
-	    if( DEBUG_MAKE )
-		if( DEBUG_MAKEQ || ! ( cmd->rule->flags & RULE_QUIETLY ) )
-	    {
-		printf( "%s ", cmd->rule->name );
-		list_print( lol_get( &cmd->args, 0 ) );
-		printf( "\n" );
-	    }
-
-	    if( DEBUG_EXEC )
-		printf( "%s\n", cmd->buf );
-
 	    if( globs.noexec )
 	    {
-		make1d( t, EXEC_CMD_OK );
+		make1banner( cmd );
+		make1d( t, EXEC_CMD_OK, (char *)0, (EXECINFO *)0 );
 	    } 
-	    else 
+	    else
 	    {
-		fflush( stdout );
-		execcmd( cmd->buf, make1d, t, cmd->shell );
+		make1push( t );
 	    }
 	}
 	else
@@ -318,6 +664,22 @@ TARGET	*t;
 	    {
 	    case EXEC_CMD_OK:
 		++counts->made;
+
+		if( !globs.noexec )
+		{
+		    hist_set( t->name, t->duration );
+		    sigdb_set( t );
+		}
+
+		/* If it came out unchanged, don't spoil its parents. */
+
+		if( !globs.noexec && make1restat( t ) )
+		{
+		    if( DEBUG_MAKEPROG )
+			printf( "...%s unchanged...\n", t->name );
+
+		    t->fate = T_FATE_STABLE;
+		}
 		break;
 	    case EXEC_CMD_FAIL:
 		++counts->failed;
@@ -329,7 +691,7 @@ TARGET	*t;
 	    t->progress = T_MAKE_DONE;
 
 	    for( c = t->parents; c; c = c->next )
-		make1b( c->target );
+		make1state( c->target, (TARGET *)0, T_STATE_MAKE1B );
 	}
 }
 
@@ -338,11 +700,32 @@ TARGET	*t;
  */
 
 static void
-make1d( t, status )
+make1d( t, status, output, info )
 TARGET	*t;
 int	status;
+char	*output;
+EXECINFO *info;
 {
 	CMD	*cmd = (CMD *)t->cmds;
+	struct jobpool *pool = 0;
+
+	if( !globs.noexec )
+	{
+	    running--;
+	    t->duration += hist_now() - t->started;
+	}
+
+	/* Show a captured command's banner and output in one go */
+
+	if( cmd->flags & EXEC_CAPTURE )
+	{
+	    make1banner( cmd );
+
+	    if( output )
+		fputs( output, stdout );
+	}
+
+	trace_action( cmd->rule->name, lol_get( &cmd->args, 0 ), status, info );
 
 	/* Execcmd() has completed.  All we need to do is fiddle with the */
 	/* status and signal our completion so make1c() can run the next */
@@ -380,6 +763,16 @@ int	status;
 		    printf( "...removing %s\n", targets->string );
 	}
 
+	/* Keep what a command made, for the action cache. */
+
+	if( status == EXEC_CMD_OK && cmd->key )
+	    acache_put( cmd, output );
+
+	/* Give back the command's place in its job pool. */
+
+	if( !globs.noexec && cmd->pool && ( pool = make1pool( cmd->pool ) ) )
+	    pool->running--;
+
 	/* Free this command and call make1c() to move onto next command. */
 
 	t->status = status;
@@ -388,6 +781,432 @@ int	status;
 	cmd_free( cmd );
 
 	make1c( t );
+
+	/* Put a target waiting on the pool back in the ready queue. */
+
+	if( pool && pool->head && pool->running < pool->limit )
+	{
+	    JOBWAIT *w = pool->head;
+
+	    if( !( pool->head = w->next ) )
+		pool->tail = 0;
+
+	    make1push( w->t );
+	    free( (char *)w );
+	}
+
+	/* Carry on with the work, if we're not already: a job */
+	/* slot is free, so start whatever is next. */
+
+	make1run();
+}
+
+/*
+ * make1restat() - did updating a target leave its file unchanged?
+ *
+ * By its time, only if $(RESTAT) is set on it (commands that copy a
+ * file with its time would fool it) and the time is from before this
+ * run began; otherwise by its content, with $(SIGFILE).  Gives the
+ * target its file's time, in place of the one make0() propagated.
+ * Not if its actions were run for another of their targets: they may
+ * not even be done with it yet.
+ */
+
+static int
+make1restat( t )
+TARGET	*t;
+{
+	time_t	before, after;
+	LIST	*restat;
+
+	if( t->flags & ( T_FLAG_NOTFILE | T_FLAG_SHARED ) ||
+	    t->binding != T_BIND_EXISTS )
+		return 0;
+
+	if( file_time( t->boundname, &after ) < 0 )
+	    return 0;
+
+	timestamp( t->boundname, &before );
+
+	pushsettings( t->settings );
+	restat = var_get( "RESTAT" );
+	popsettings( t->settings );
+
+	if( !( restat && after == before && before < began - 1 ) &&
+	    !sigdb_same( t ) )
+		return 0;
+
+	t->time = after;
+
+	return 1;
+}
+
+/*
+ * make1cutoff() - did all a target's updated dependents come out unchanged?
+ *
+ * If so, decides the target's fate as make0() would have, from the
+ * times its dependents have now: returns 1 if it needn't be updated.
+ */
+
+static int
+make1cutoff( t )
+TARGET	*t;
+{
+	struct hash *seen;
+	TARGETS	*c;
+	time_t	last = 0;
+	time_t	time;
+	int	ok = 1;
+
+	/* Targets to be updated regardless. */
+
+	if( anyhow || t->flags & ( T_FLAG_TOUCHED | T_FLAG_LEAVES | T_FLAG_TEMP ) )
+	    return 0;
+
+	if( !( t->flags & T_FLAG_NOTFILE ) && t->binding != T_BIND_EXISTS )
+	    return 0;
+
+	/* Usually, a dependent changed: don't bother with the rest. */
+
+	for( c = t->deps[ T_DEPS_DEPENDS ]; c; c = c->next )
+	    if( c->target->fate >= T_FATE_SPOIL )
+		return 0;
+
+	seen = hashinit( sizeof( char * ), "cutoff" );
+
+	for( c = t->deps[ T_DEPS_DEPENDS ]; c && ok; c = c->next )
+	    ok = make1last( c->target, seen, &last );
+
+	hashdone( seen );
+
+	if( !ok )
+	    return 0;
+
+	if( t->flags & T_FLAG_NOTFILE )
+	{
+	    t->time = last;
+	    return 1;
+	}
+
+	if( t->flags & T_FLAG_NOUPDATE )
+	    last = 0;
+
+	timestamp( t->boundname, &time );
+
+	if( last > time && !( t->actions && sigdb_check( t ) ) )
+	    return 0;
+
+	t->time = max( time, last );
+
+	return 1;
+}
+
+/*
+ * make1last() - find the latest time among a target's dependents
+ *
+ * Takes in the target and, as make0() does, the headers it includes.
+ * Returns 0 if any is still to be (or was) updated and changed.
+ */
+
+static int
+make1last( t, seen, last )
+TARGET	*t;
+struct hash *seen;
+time_t	*last;
+{
+	char	**p = &t->name;
+	TARGETS	*c;
+
+	if( !hashenter( seen, (HASHDATA **)&p ) )
+	    return 1;
+
+	if( t->fate >= T_FATE_SPOIL )
+	    return 0;
+
+	*last = max( *last, t->time );
+
+	for( c = t->deps[ T_DEPS_INCLUDES ]; c; c = c->next )
+	    if( !make1last( c->target, seen, last ) )
+		return 0;
+
+	return 1;
+}
+
+/*
+ * make1mark() - note the content of an action's targets before it runs
+ *
+ * For make1restat(): done for all of $(<) as the action is taken on,
+ * as it may rewrite them before make1b() gets to the others.
+ */
+
+static void
+make1mark( targets )
+TARGETS	*targets;
+{
+	if( globs.noexec )
+	    return;
+
+	for( ; targets; targets = targets->next )
+	    if( targets->target->binding == T_BIND_EXISTS )
+		sigdb_mark( targets->target );
+}
+
+/*
+ * make1prioritize() - rank targets by the longest path to the top
+ *
+ * A target's priority is how long its commands take plus the
+ * priority of its most demanding parent.  Walking make1a()'s
+ * postorder backwards sees all of a target's parents before it.
+ */
+
+static void
+make1prioritize()
+{
+	TARGETS	*c;
+	int	i, j, ms, p;
+	int	known = 0;
+	int	total = 0;
+	int	longest = 0;
+	int	dflt;
+
+	/* Targets without history are guessed to take the average. */
+
+	for( i = 0; i < norder; i++ )
+	    if( ( ms = make1cost( order[i], 0 ) ) > 0 )
+	{
+	    known++;
+	    total += ms;
+	}
+
+	dflt = known && total / known > 1 ? total / known : 1;
+
+	for( i = 0; i < norder; i++ )
+	    order[i]->priority = make1cost( order[i], dflt );
+
+	for( i = norder; i--; )
+	    for( j = T_DEPS_DEPENDS; j <= T_DEPS_INCLUDES; j++ )
+		for( c = order[i]->deps[j]; c; c = c->next )
+	{
+	    p = order[i]->priority + make1cost( c->target, dflt );
+
+	    if( p > c->target->priority )
+		c->target->priority = p;
+	}
+
+	for( i = 0; i < norder; i++ )
+	    if( order[i]->priority > longest )
+		longest = order[i]->priority;
+
+	if( DEBUG_MAKEPROG && norder )
+	    printf( "make1: %d target(s), %d with history, longest path %dms\n",
+		norder, known, longest );
+
+	free( (char *)order );
+	order = 0;
+	norder = maxorder = 0;
+
+	/* Re-heap what make1a() left ready, now that it's ranked. */
+
+	i = nready;
+	nready = 0;
+
+	while( nready < i )
+	    make1push( ready[ nready ].t );
+
+	prioritized = 1;
+}
+
+/*
+ * make1dispatch() - start ready targets' commands, highest rank first
+ */
+
+static void
+make1dispatch()
+{
+	if( !prioritized && !early )
+	    return;
+
+	while( nready && ( running < globs.jobs || !running ) )
+	    make1exec( make1pop() );
+}
+
+/*
+ * make1exec() - start a target's next command
+ */
+
+static void
+make1exec( t )
+TARGET	*t;
+{
+	CMD	*cmd = (CMD *)t->cmds;
+	struct jobpool *pool;
+	char	*output;
+
+	/* After an interrupt, start nothing new. */
+
+	if( intr )
+	{
+	    t->status = EXEC_CMD_INTR;
+	    make1c( t );
+	    return;
+	}
+
+	/* If the command's job pool is full, wait in line. */
+	/* make1d() will put us back in the ready queue. */
+
+	if( cmd->pool && ( pool = make1pool( cmd->pool ) ) )
+	{
+	    if( pool->running >= pool->limit )
+	    {
+		JOBWAIT *w = (JOBWAIT *)malloc( sizeof( JOBWAIT ) );
+
+		w->t = t;
+		w->next = 0;
+
+		if( pool->tail )
+		    pool->tail->next = w;
+		else
+		    pool->head = w;
+
+		pool->tail = w;
+		return;
+	    }
+
+	    pool->running++;
+	}
+
+	running++;
+	t->started = hist_now();
+
+	/* If the action cache has the command's targets, make1d() */
+	/* shows its banner and output as if it had just run. */
+
+	if( cmd->key && acache_get( cmd, &output ) )
+	{
+	    ++counts->cached;
+	    free( cmd->key );
+	    cmd->key = 0;
+	    cmd->flags |= EXEC_CAPTURE;
+	    make1d( t, EXEC_CMD_OK, output, (EXECINFO *)0 );
+	    free( output );
+	    return;
+	}
+
+	/* With -j, the command's output is captured and make1d() */
+	/* shows it together with the banner, so the output of */
+	/* parallel commands doesn't get mixed up.  So it is for */
+	/* a command to be put in the action cache. */
+
+	if( globs.jobs > 1 || cmd->key )
+	{
+	    cmd->flags |= EXEC_CAPTURE;
+	    execcmd( cmd->buf, make1d, t, cmd->shell, cmd->flags );
+	}
+	else 
+	{
+	    make1banner( cmd );
+	    fflush( stdout );
+	    execcmd( cmd->buf, make1d, t, cmd->shell, cmd->flags );
+	}
+}
+
+/*
+ * make1push() - add a target to the ready queue
+ */
+
+# define READYBEFORE( a, b ) \
+	( (a)->t->priority > (b)->t->priority || \
+	  (a)->t->priority == (b)->t->priority && (a)->seq < (b)->seq )
+
+static void
+make1push( t )
+TARGET	*t;
+{
+	struct ready r;
+	int	i;
+
+	if( nready == maxready )
+	{
+	    maxready = maxready ? maxready * 2 : 64;
+	    ready = (struct ready *)realloc( (char *)ready, 
+				maxready * sizeof( struct ready ) );
+	}
+
+	r.t = t;
+	r.seq = readyseq++;
+
+	for( i = nready++; i && READYBEFORE( &r, &ready[ ( i - 1 ) / 2 ] ); 
+	     i = ( i - 1 ) / 2 )
+		ready[i] = ready[ ( i - 1 ) / 2 ];
+
+	ready[i] = r;
+}
+
+/*
+ * make1pop() - take the highest ranked target off the ready queue
+ */
+
+static TARGET *
+make1pop()
+{
+	TARGET	*t = ready[0].t;
+	struct ready r = ready[ --nready ];
+	int	i, c;
+
+	for( i = 0; ( c = 2 * i + 1 ) < nready; i = c )
+	{
+	    if( c + 1 < nready && READYBEFORE( &ready[ c + 1 ], &ready[c] ) )
+		c++;
+
+	    if( !READYBEFORE( &ready[c], &r ) )
+		break;
+
+	    ready[i] = ready[c];
+	}
+
+	ready[i] = r;
+
+	return t;
+}
+
+/*
+ * make1cost() - guess how long a target's commands will take
+ *
+ * Returns 0 for targets that won't be updated, else their time
+ * from $(JAMHISTORY), or dflt.
+ */
+
+static int
+make1cost( t, dflt )
+TARGET	*t;
+int	dflt;
+{
+	int	ms;
+
+	if( !t->actions || t->fate < T_FATE_BUILD || t->fate >= T_FATE_BROKEN )
+	    return 0;
+
+	return ( ms = hist_get( t->name ) ) >= 0 ? ms : dflt;
+}
+
+/*
+ * make1banner() - show the action being run (and its text, with -d2)
+ */
+
+static void
+make1banner( cmd )
+CMD	*cmd;
+{
+	if( DEBUG_MAKE )
+	    if( DEBUG_MAKEQ || ! ( cmd->rule->flags & RULE_QUIETLY ) )
+	{
+	    printf( "%s ", cmd->rule->name );
+	    list_print( lol_get( &cmd->args, 0 ) );
+	    printf( "\n" );
+	}
+
+	if( DEBUG_EXEC )
+	    printf( "%s\n", cmd->buf );
 }
 
 /*
@@ -405,7 +1224,16 @@ make1cmds( a0 )
 ACTIONS	*a0;
 {
 	CMD *cmds = 0;
+	CMD *c;
 	LIST *shell = var_get( "JAMSHELL" );	/* shell is per-target */
+	LIST *pool = var_get( "JOBPOOL" );	/* so is the job pool */
+	int flags = 0;
+
+	/* $(NOSHELLBYPASS) is per-target, too: rules set it on $(<) */
+	/* if their actions must always be run by the shell. */
+
+	if( var_get( "NOSHELLBYPASS" ) )
+	    flags |= EXEC_SHELL;
 
 	/* Step through actions */
 	/* Actions may be shared with other targets or grouped with */
@@ -426,6 +1254,7 @@ ACTIONS	*a0;
 		continue;
 
 	    a0->action->running = 1;
+	    make1mark( a0->action->targets );
 	    
 	    /* Make LISTS of targets and sources */
 	    /* If `execute together` has been specified for this rule, tack */
@@ -440,6 +1269,7 @@ ACTIONS	*a0;
 	    {
 		ns = make1list( ns, a1->action->sources, rule->flags );
 		a1->action->running = 1;
+		make1mark( a1->action->targets );
 	    }
 
 	    /* If doing only updated (or existing) sources, but none have */
@@ -465,13 +1295,6 @@ ACTIONS	*a0;
 
 	    /* Either cut the actions into pieces, or do it whole. */
 
-	    if( chunk < 0 )
-	    {
-		printf( "fatal error: %s command line too long (max %d)\n", 
-			rule->name, MAXLINE );
-		exit( EXITBAD );
-	    }
-
 	    if( chunk )
 	    {
 		int  start;
@@ -486,7 +1309,7 @@ ACTIONS	*a0;
 		{
 		    cmds = cmd_new( cmds, rule, 
 				list_copy( L0, nt ), somes, 
-				list_copy( L0, shell ) );
+				list_copy( L0, shell ), flags );
 		}
 
 		list_free( nt );
@@ -494,7 +1317,8 @@ ACTIONS	*a0;
 	    }
 	    else
 	    {
-		cmds = cmd_new( cmds, rule, nt, ns, list_copy( L0, shell ) );
+		cmds = cmd_new( cmds, rule, nt, ns, 
+				list_copy( L0, shell ), flags );
 	    }
 
 	    /* Free the variables whose values were bound by */
@@ -504,9 +1328,67 @@ ACTIONS	*a0;
 	    freesettings( boundvars );
 	}
 
+	if( pool )
+	    for( c = cmds; c; c = c->next )
+		c->pool = pool->string;
+
 	return cmds;
 }
 
+/*
+ * make1pool() - find a job pool, setting them up from $(JOBPOOLS)
+ *
+ * Returns 0 for a pool that $(JOBPOOLS) doesn't limit.
+ */
+
+static struct jobpool *
+make1pool( name )
+char	*name;
+{
+	struct jobpool pool, *p = &pool;
+
+	if( !jobpools )
+	{
+	    LIST *l;
+
+	    jobpools = hashinit( sizeof( struct jobpool ), "jobpools" );
+
+	    for( l = var_get( "JOBPOOLS" ); l; l = list_next( l ) )
+	    {
+		char *eq = strchr( l->string, '=' );
+		char buf[ MAXSYM ];
+
+		if( !eq || eq == l->string || eq - l->string >= MAXSYM || 
+		    atoi( eq + 1 ) < 1 )
+		{
+		    printf( "warning: JOBPOOLS: ignoring %s\n", l->string );
+		    continue;
+		}
+
+		memcpy( buf, l->string, eq - l->string );
+		buf[ eq - l->string ] = '\0';
+
+		p = &pool;
+		p->name = buf;
+
+		if( hashenter( jobpools, (HASHDATA **)&p ) )
+		{
+		    p->name = newstr( buf );
+		    p->running = 0;
+		    p->head = p->tail = 0;
+		}
+
+		p->limit = atoi( eq + 1 );
+	    }
+
+	    p = &pool;
+	}
+
+	p->name = name;
+
+	return hashcheck( jobpools, (HASHDATA **)&p ) ? p : 0;
+}
+
 /*
  * make1chunk() - compute number of source that can fit on cmd line
  */
@@ -520,7 +1402,6 @@ LIST	*sources;
 	int onesize;
 	int twosize;
 	int chunk = 0;
-	char buf[ MAXLINE ];
 	LOL lol;
 
 	/* XXX -- egregious manipulation of lol */
@@ -531,22 +1412,22 @@ LIST	*sources;
 	lol.list[0] = targets;
 
 	lol.list[1] = list_sublist( sources, 0, 1 );
-	onesize = var_string( cmd, buf, MAXLINE, &lol );
+	free( var_string( cmd, &lol, &onesize ) );
 	list_free( lol.list[1] );
 
-	if( onesize < 0 )
-	    return -1;
-
 	lol.list[1] = list_sublist( sources, 0, 2 );
-	twosize = var_string( cmd, buf, MAXLINE, &lol );
+	free( var_string( cmd, &lol, &twosize ) );
 	list_free( lol.list[1] );
 
-	if( twosize < 0 )
-	    return -1;
+	/* If even one source overflows MAXLINE, go one at a time: */
+	/* the command buffer itself is no longer limited. */
 
 	if( twosize > onesize )
 	    chunk = 3 * ( MAXLINE - onesize ) / 5 / ( twosize - onesize ) + 1;
 
+	if( twosize > onesize && chunk < 1 )
+	    chunk = 1;
+
 	return chunk;
 }
 
@@ -0,0 +1,23 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * md5.h - the MD5 message digest (RFC 1321)
+ */
+
+typedef struct _md5 MD5;
+
+struct _md5 {
+	unsigned long	state[4];
+	unsigned long	count[2];	/* bits, low word first */
+	unsigned char	buf[64];
+} ;
+
+# define MD5_SIZE	16		/* bytes in a digest */
+
+void md5_init();
+void md5_update();
+void md5_final();
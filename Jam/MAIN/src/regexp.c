@@ -34,6 +34,13 @@
  *** soul, was removed so it can compile everywhere.  The declaration
  *** of strchr() was in conflict on AIX, so it was removed (as it is
  *** happily defined in string.h).
+ *** THIS IS AN ALTERED VERSION.  It was altered for jam so that
+ *** regexec() keeps its work variables in a per-call struct rather
+ *** than globals, and with regexec_r(), which leaves the matched
+ *** substrings in arrays of the caller's rather than in the regexp,
+ *** one regexp can be used by several threads at once.  It was also
+ *** given regset_exec(), which matches several regexps at once with an
+ *** NFA simulation rather than by backtracking.
  *
  * Beware that some of this code is subtly aware of the way operator
  * precedence is structured in regular expressions.  Serious changes in
@@ -768,12 +775,20 @@ char *val;
  */
 
 /*
- * Global work variables for regexec().
+ * Work variables for regexec(), kept per call rather than global, so
+ * that several threads can be running regexec_r() at once.
  */
-static char *reginput;		/* String-input pointer. */
-static char *regbol;		/* Beginning of input, for ^ check. */
-static char **regstartp;	/* Pointer to startp array. */
-static char **regendp;		/* Ditto for endp. */
+struct regexec_state {
+	char *input;		/* String-input pointer. */
+	char *bol;		/* Beginning of input, for ^ check. */
+	char **startp;		/* Pointer to startp array. */
+	char **endp;		/* Ditto for endp. */
+};
+
+#define reginput	(rs->input)
+#define regbol		(rs->bol)
+#define regstartp	(rs->startp)
+#define regendp		(rs->endp)
 
 /*
  * Forwards.
@@ -795,8 +810,25 @@ int
 regexec(prog, string)
 register regexp *prog;
 register char *string;
+{
+	if (prog == NULL)
+		return(regexec_r(prog, string, (char **)NULL, (char **)NULL));
+	return(regexec_r(prog, string, prog->startp, prog->endp));
+}
+
+/*
+ - regexec_r - match a regexp against a string, leaving the substrings
+ - matched in startp[] and endp[] (each of NSUBEXP) instead of in prog
+ */
+int
+regexec_r(prog, string, startp, endp)
+register regexp *prog;
+register char *string;
+char **startp;
+char **endp;
 {
 	register char *s;
+	struct regexec_state state, *rs = &state;
 
 	/* Be paranoid... */
 	if (prog == NULL || string == NULL) {
@@ -824,24 +856,26 @@ register char *string;
 
 	/* Mark beginning of line for ^ . */
 	regbol = (char *)string;
+	regstartp = startp;
+	regendp = endp;
 
 	/* Simplest case:  anchored match need be tried only once. */
 	if (prog->reganch)
-		return(regtry(prog, string));
+		return(regtry(rs, prog, string));
 
 	/* Messy cases:  unanchored match. */
 	s = (char *)string;
 	if (prog->regstart != '\0')
 		/* We know what char it must start with. */
 		while ((s = strchr(s, prog->regstart)) != NULL) {
-			if (regtry(prog, s))
+			if (regtry(rs, prog, s))
 				return(1);
 			s++;
 		}
 	else
 		/* We don't -- general case. */
 		do {
-			if (regtry(prog, s))
+			if (regtry(rs, prog, s))
 				return(1);
 		} while (*s++ != '\0');
 
@@ -853,7 +887,8 @@ register char *string;
  - regtry - try match at specific point
  */
 static int			/* 0 failure, 1 success */
-regtry(prog, string)
+regtry(rs, prog, string)
+struct regexec_state *rs;
 regexp *prog;
 char *string;
 {
@@ -862,18 +897,16 @@ char *string;
 	register char **ep;
 
 	reginput = string;
-	regstartp = prog->startp;
-	regendp = prog->endp;
 
-	sp = prog->startp;
-	ep = prog->endp;
+	sp = regstartp;
+	ep = regendp;
 	for (i = NSUBEXP; i > 0; i--) {
 		*sp++ = NULL;
 		*ep++ = NULL;
 	}
-	if (regmatch(prog->program + 1)) {
-		prog->startp[0] = string;
-		prog->endp[0] = reginput;
+	if (regmatch(rs, prog->program + 1)) {
+		regstartp[0] = string;
+		regendp[0] = reginput;
 		return(1);
 	} else
 		return(0);
@@ -890,7 +923,8 @@ char *string;
  * by recursion.
  */
 static int			/* 0 failure, 1 success */
-regmatch(prog)
+regmatch(rs, prog)
+struct regexec_state *rs;
 char *prog;
 {
 	register char *scan;	/* Current node. */
@@ -980,7 +1014,7 @@ char *prog;
 				no = OP(scan) - OPEN;
 				save = reginput;
 
-				if (regmatch(next)) {
+				if (regmatch(rs, next)) {
 					/*
 					 * Don't set startp if some later
 					 * invocation of the same parentheses
@@ -1008,7 +1042,7 @@ char *prog;
 				no = OP(scan) - CLOSE;
 				save = reginput;
 
-				if (regmatch(next)) {
+				if (regmatch(rs, next)) {
 					/*
 					 * Don't set endp if some later
 					 * invocation of the same parentheses
@@ -1029,7 +1063,7 @@ char *prog;
 				else {
 					do {
 						save = reginput;
-						if (regmatch(OPERAND(scan)))
+						if (regmatch(rs, OPERAND(scan)))
 							return(1);
 						reginput = save;
 						scan = regnext(scan);
@@ -1055,11 +1089,11 @@ char *prog;
 					nextch = *OPERAND(next);
 				min = (OP(scan) == STAR) ? 0 : 1;
 				save = reginput;
-				no = regrepeat(OPERAND(scan));
+				no = regrepeat(rs, OPERAND(scan));
 				while (no >= min) {
 					/* If it could work, try it. */
 					if (nextch == '\0' || *reginput == nextch)
-						if (regmatch(next))
+						if (regmatch(rs, next))
 							return(1);
 					/* Couldn't or didn't -- back up. */
 					no--;
@@ -1092,7 +1126,8 @@ char *prog;
  - regrepeat - repeatedly match something simple, report how many
  */
 static int
-regrepeat(p)
+regrepeat(rs, p)
+struct regexec_state *rs;
 char *p;
 {
 	register int count = 0;
@@ -1156,6 +1191,455 @@ register char *p;
 		return(p+offset);
 }
 
+/*
+ * regset_new(), regset_exec(), regset_free() - match several regexps
+ * against a string at once
+ *
+ * This is a Thompson NFA simulation (after Pike) run directly on the
+ * compiled programs, rather than a backtracking search: the threads
+ * of all the regexps in the set advance together, one character at a
+ * time, so the string is read once however many regexps there are,
+ * and no regexp can take worse than linear time.  Among matches, it
+ * picks the one regexec() would: leftmost, then by the first BRANCH
+ * alternative and longest STAR or PLUS to get there.
+ *
+ * Before any of that, a regexp is only tried if the string contains
+ * its regstart character and the longest literal every match must
+ * contain: most lines of a source file fail these, and never get to
+ * the NFA.
+ *
+ * A regset holds only working storage and pointers to the regexps,
+ * which it only reads: any number of regsets, on any number of
+ * threads, can share the regexps.
+ */
+
+struct rethread {
+	char *pc;		/* Node to match next. */
+	int n;			/* EXACTLY: chars matched; STAR/PLUS: 1 if looping. */
+	int prog;		/* Which regexp in the set. */
+	char *sub[2*NSUBEXP];	/* startp[0], endp[0], startp[1]... */
+};
+
+struct relist {
+	int n;
+	struct rethread *t;
+};
+
+struct regset {
+	int nprog;
+	regexp **prog;
+	char **must;		/* Literal a match must contain, or NULL. */
+	int *base;		/* Where each regexp's marks start in mark[]. */
+	int *nsub;		/* How much of sub[] each regexp uses. */
+	int *mark;		/* Step each state was last added to a list. */
+	int step;
+	char *live;		/* Regexp passed the prefilter, not yet matched. */
+	char *cut;		/* Regexp matched in this step. */
+	struct relist list[2];
+};
+
+STATIC int regsetsize();
+STATIC void regaddthread();
+
+/*
+ - regset_new - set up to match the n regexps in prog[] at once
+ *
+ * A NULL regexp (one that didn't compile) never matches.
+ */
+regset *
+regset_new(prog, n)
+regexp **prog;
+int n;
+{
+	register regset *set;
+	register char *scan;
+	register int i;
+	int size = 0;
+	unsigned len;
+
+	set = (regset *)malloc(sizeof(regset));
+	set->nprog = n;
+	set->prog = (regexp **)malloc(n * sizeof(regexp *) + 1);
+	set->must = (char **)malloc(n * sizeof(char *) + 1);
+	set->base = (int *)malloc(n * sizeof(int) + 1);
+	set->nsub = (int *)malloc(n * sizeof(int) + 1);
+	set->live = malloc(n + 1);
+	set->cut = malloc(n + 1);
+
+	for (i = 0; i < n; i++) {
+		set->prog[i] = prog[i];
+		set->must[i] = NULL;
+		set->base[i] = size;
+		set->nsub[i] = 2;
+
+		if (prog[i] == NULL)
+			continue;
+
+		size += regsetsize(prog[i], &set->nsub[i]);
+
+		/*
+		 * Find the longest literal that must appear, as regcomp()
+		 * does for regmust, but whether or not the r.e. is expensive.
+		 */
+		scan = prog[i]->program + 1;
+		if (OP(regnext(scan)) != END)
+			continue;
+		len = 0;
+		for (scan = OPERAND(scan); scan != NULL; scan = regnext(scan))
+			if (OP(scan) == EXACTLY && strlen(OPERAND(scan)) >= len) {
+				set->must[i] = OPERAND(scan);
+				len = strlen(OPERAND(scan));
+			}
+	}
+
+	/* Each state is in a list at most once per step. */
+	set->mark = (int *)malloc(size * sizeof(int) + 1);
+	for (i = 0; i < size; i++)
+		set->mark[i] = 0;
+	set->step = 0;
+
+	for (i = 0; i < 2; i++) {
+		set->list[i].n = 0;
+		set->list[i].t = (struct rethread *)
+			malloc(size * sizeof(struct rethread) + 1);
+	}
+
+	return(set);
+}
+
+/*
+ - regset_free - free a regset, but not its regexps
+ */
+void
+regset_free(set)
+regset *set;
+{
+	free((char *)set->list[0].t);
+	free((char *)set->list[1].t);
+	free((char *)set->mark);
+	free(set->cut);
+	free(set->live);
+	free((char *)set->nsub);
+	free((char *)set->base);
+	free((char *)set->must);
+	free((char *)set->prog);
+	free((char *)set);
+}
+
+/*
+ - regset_exec - match all the regexps of a set against a string
+ *
+ * For each regexp i that matches, its substrings are left in
+ * startp[i*NSUBEXP...] and endp[i*NSUBEXP...]; for one that doesn't,
+ * startp[i*NSUBEXP] is NULL.  Returns how many matched.
+ */
+int
+regset_exec(set, string, startp, endp)
+register regset *set;
+char *string;
+char **startp;
+char **endp;
+{
+	register struct relist *clist, *nlist, *tmp;
+	register struct rethread *t;
+	register char *sp;
+	register char *opnd;
+	register int i;
+	int live = 0;		/* Regexps still looking... */
+	int unanch = 0;		/* ...that can start anywhere. */
+	int matched = 0;
+	char *sub[2*NSUBEXP];
+	int cuts = 1;
+	int ok, len;
+
+	/* Prefilter: a regexp can't match without its literals. */
+	for (i = 0; i < set->nprog; i++) {
+		register regexp *prog = set->prog[i];
+
+		startp[i*NSUBEXP] = NULL;
+		set->live[i] = prog != NULL &&
+			(prog->regstart == '\0' ||
+				strchr(string, prog->regstart) != NULL) &&
+			(set->must[i] == NULL ||
+				strstr(string, set->must[i]) != NULL);
+		live += set->live[i];
+		unanch += set->live[i] && !prog->reganch;
+	}
+
+	if (!live)
+		return(0);
+
+	clist = &set->list[0];
+	nlist = &set->list[1];
+	clist->n = 0;
+	set->step++;
+
+	for (sp = string; ; sp++) {
+		/* Start each regexp still looking, at lowest priority. */
+		for (i = 0; i < set->nprog; i++) {
+			if (!set->live[i] || (set->prog[i]->reganch && sp != string))
+				continue;
+			for (ok = 1; ok < set->nsub[i]; ok++)
+				sub[ok] = NULL;
+			sub[0] = sp;
+			regaddthread(set, clist, set->prog[i]->program + 1, 0, i,
+				sub, string, sp);
+		}
+
+		/* No threads, and none to start here or later? */
+		if (clist->n == 0 && (!unanch || *sp == '\0'))
+			break;
+
+		/* Advance each thread over *sp, into nlist. */
+		set->step++;
+		nlist->n = 0;
+		for (i = 0; cuts && i < set->nprog; i++)
+			set->cut[i] = 0;
+		cuts = 0;
+
+		for (t = clist->t; t < clist->t + clist->n; t++) {
+			if (set->cut[t->prog])
+				continue;
+
+			opnd = OPERAND(t->pc);
+
+			switch (OP(t->pc)) {
+			case END:
+				/* Later threads of this regexp lose to this one. */
+				set->cut[t->prog] = 1;
+				cuts = 1;
+				if (startp[t->prog*NSUBEXP] == NULL)
+					matched++;
+				if (set->live[t->prog]) {
+					set->live[t->prog] = 0;
+					live--;
+					unanch -= !set->prog[t->prog]->reganch;
+				}
+				t->sub[1] = sp;
+				for (i = 0; i < NSUBEXP; i++) {
+					ok = 2*i < set->nsub[t->prog];
+					startp[t->prog*NSUBEXP+i] = ok ? t->sub[2*i] : NULL;
+					endp[t->prog*NSUBEXP+i] = ok ? t->sub[2*i+1] : NULL;
+				}
+				continue;
+			case EXACTLY:
+				/*
+				 * A lone thread, with nothing to start behind it,
+				 * can take the rest of its string at once.
+				 */
+				if (clist->n == 1 && !unanch) {
+					len = strlen(opnd + t->n);
+					ok = strncmp(opnd + t->n, sp, len) == 0;
+					if (ok)
+						sp += len - 1;
+					break;
+				}
+				ok = *sp != '\0' && opnd[t->n] == *sp;
+				if (ok && opnd[t->n+1] != '\0') {
+					regaddthread(set, nlist, t->pc, t->n+1, t->prog,
+						t->sub, string, sp+1);
+					continue;
+				}
+				break;
+			case ANY:
+				ok = *sp != '\0';
+				break;
+			case ANYOF:
+				ok = *sp != '\0' && strchr(opnd, *sp) != NULL;
+				break;
+			case ANYBUT:
+				ok = *sp != '\0' && strchr(opnd, *sp) == NULL;
+				break;
+			case STAR:
+			case PLUS:
+				switch (OP(opnd)) {
+				case ANY:
+					ok = *sp != '\0';
+					break;
+				case EXACTLY:
+					ok = *sp != '\0' && *OPERAND(opnd) == *sp;
+					break;
+				case ANYOF:
+					ok = *sp != '\0' && strchr(OPERAND(opnd), *sp) != NULL;
+					break;
+				case ANYBUT:
+					ok = *sp != '\0' && strchr(OPERAND(opnd), *sp) == NULL;
+					break;
+				default:
+					ok = 0;
+					break;
+				}
+				if (ok)
+					regaddthread(set, nlist, t->pc, 1, t->prog,
+						t->sub, string, sp+1);
+				continue;
+			default:
+				ok = 0;
+				break;
+			}
+
+			if (ok)
+				regaddthread(set, nlist, regnext(t->pc), 0, t->prog,
+					t->sub, string, sp+1);
+		}
+
+		if (*sp == '\0')
+			break;
+
+		tmp = clist;
+		clist = nlist;
+		nlist = tmp;
+	}
+
+	return(matched);
+}
+
+/*
+ - regsetsize - how many bytes a regexp's program takes
+ *
+ * Also raises *nsub to cover the highest numbered () in sub[].
+ */
+static int
+regsetsize(prog, nsub)
+regexp *prog;
+int *nsub;
+{
+	register char *s;
+	register char op = EXACTLY;	/* Arbitrary non-END op. */
+
+	s = prog->program + 1;
+	while (op != END) {
+		op = OP(s);
+		if (op > CLOSE && op < CLOSE + NSUBEXP && *nsub < 2*(op - CLOSE) + 2)
+			*nsub = 2*(op - CLOSE) + 2;
+		s += 3;
+		if (op == ANYOF || op == ANYBUT || op == EXACTLY)
+			s += strlen(s) + 1;
+	}
+
+	return(s - prog->program);
+}
+
+/*
+ - regaddthread - add a thread at pc to a list, following empty moves
+ *
+ * Threads are added in priority order: a BRANCH's alternatives in
+ * turn, and at a STAR or PLUS, another time round before what follows.
+ * sp is where in string the thread is; OPEN and CLOSE mark it in sub[].
+ */
+static void
+regaddthread(set, list, pc, n, prog, sub, string, sp)
+regset *set;
+struct relist *list;
+char *pc;
+int n;
+int prog;
+char **sub;
+char *string;
+char *sp;
+{
+	register struct rethread *t;
+	register char *next;
+	register int *mark;
+	char *save;
+	int no;
+
+	if (pc == NULL)
+		return;
+
+	/*
+	 * Each state has its own mark: a node's is at its opcode, the
+	 * rest of an EXACTLY's at its operand, and a looping STAR or
+	 * PLUS's at its next pointer.
+	 */
+	next = OP(pc) == EXACTLY ? OPERAND(pc) + n : pc + n;
+	mark = &set->mark[set->base[prog] + (next - set->prog[prog]->program)];
+	if (*mark == set->step)
+		return;
+	*mark = set->step;
+
+	next = regnext(pc);
+
+	switch (OP(pc)) {
+	case BOL:
+		if (sp == string)
+			regaddthread(set, list, next, 0, prog, sub, string, sp);
+		return;
+	case EOL:
+		if (*sp == '\0')
+			regaddthread(set, list, next, 0, prog, sub, string, sp);
+		return;
+	case WORDA:
+		if ((isalnum(*sp) || *sp == '_') &&
+		    (sp == string || (!isalnum(sp[-1]) && sp[-1] != '_')))
+			regaddthread(set, list, next, 0, prog, sub, string, sp);
+		return;
+	case WORDZ:
+		if (!isalnum(*sp) && *sp != '_')
+			regaddthread(set, list, next, 0, prog, sub, string, sp);
+		return;
+	case BRANCH:
+		if (OP(next) != BRANCH)		/* No choice. */
+			regaddthread(set, list, OPERAND(pc), 0, prog, sub, string, sp);
+		else
+			for (; pc != NULL && OP(pc) == BRANCH; pc = regnext(pc))
+				regaddthread(set, list, OPERAND(pc), 0, prog, sub,
+					string, sp);
+		return;
+	case NOTHING:
+	case BACK:
+		regaddthread(set, list, next, 0, prog, sub, string, sp);
+		return;
+	case STAR:
+		if (n == 0) {
+			regaddthread(set, list, pc, 1, prog, sub, string, sp);
+			return;
+		}
+		break;
+	case OPEN+1:
+	case OPEN+2:
+	case OPEN+3:
+	case OPEN+4:
+	case OPEN+5:
+	case OPEN+6:
+	case OPEN+7:
+	case OPEN+8:
+	case OPEN+9:
+		no = 2*(OP(pc) - OPEN);
+		save = sub[no];
+		sub[no] = sp;
+		regaddthread(set, list, next, 0, prog, sub, string, sp);
+		sub[no] = save;
+		return;
+	case CLOSE+1:
+	case CLOSE+2:
+	case CLOSE+3:
+	case CLOSE+4:
+	case CLOSE+5:
+	case CLOSE+6:
+	case CLOSE+7:
+	case CLOSE+8:
+	case CLOSE+9:
+		no = 2*(OP(pc) - CLOSE) + 1;
+		save = sub[no];
+		sub[no] = sp;
+		regaddthread(set, list, next, 0, prog, sub, string, sp);
+		sub[no] = save;
+		return;
+	}
+
+	/* END, or something that takes a character: a thread of its own. */
+	t = &list->t[list->n++];
+	t->pc = pc;
+	t->n = n;
+	t->prog = prog;
+	memcpy((char *)t->sub, (char *)sub, set->nsub[prog] * sizeof(char *));
+
+	/* A looping STAR or PLUS may also stop here. */
+	if ((OP(pc) == STAR || OP(pc) == PLUS) && n == 1)
+		regaddthread(set, list, next, 0, prog, sub, string, sp);
+}
+
 #ifdef DEBUG
 
 STATIC char *regprop();
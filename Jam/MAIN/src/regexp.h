@@ -15,8 +15,17 @@ typedef struct regexp {
 	char program[1];	/* Unwarranted chumminess with compiler. */
 } regexp;
 
+/*
+ * A set of regexps to match at once, with regset_exec().
+ */
+typedef struct regset regset;
+
 extern regexp *regcomp();
 extern int regexec();
+extern int regexec_r();
+extern regset *regset_new();
+extern int regset_exec();
+extern void regset_free();
 extern void regsub();
 extern void regerror();
 
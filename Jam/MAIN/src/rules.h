@@ -104,6 +104,7 @@ struct _target {
 # define	T_FLAG_TOUCHED	0x08	/* ALWAYS applied or -t target */
 # define	T_FLAG_LEAVES	0x10	/* LEAVES applied */
 # define	T_FLAG_NOUPDATE	0x20	/* NOUPDATE applied */
+# define	T_FLAG_SHARED	0x40	/* actions run for another target */
 
 	char	binding;		/* how target relates to real file */
 
@@ -157,6 +158,10 @@ struct _target {
 	int	asynccnt;		/* child deps outstanding */
 	TARGETS	*parents;		/* used by make1() for completion */
 	char	*cmds;			/* type-punned command list */
+
+	int	priority;		/* make1() runs highest first */
+	int	duration;		/* ms spent running commands */
+	int	started;		/* when running command started */
 } ;
 
 RULE	*bindrule();
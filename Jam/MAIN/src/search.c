@@ -15,9 +15,54 @@
 # include "filesys.h"
 # include "variable.h"
 # include "newstr.h"
+# include "hash.h"
 
 /*
  * search.c - find a target along $(SEARCH) or $(LOCATE) 
+ *
+ * External routines:
+ *
+ *	search() - find a target, returning its bound name and time
+ *	search_prefetch() - start scanning where search() will look
+ *
+ * Internal routines:
+ *
+ *	search_skip() - count the $(SEARCH) directories a file isn't in
+ *	search_index() - index the files along a $(SEARCH)
+ *
+ * Rather than try each directory of a long $(SEARCH) in turn, search()
+ * looks up a plain file name in an index of the files along the whole
+ * $(SEARCH), built from the directory scans timestamp() does anyway.
+ * The index says which directory the file is first in, and search()
+ * starts there.  There is one index for each different $(SEARCH).
+ */
+
+# define SEARCH_INDEX_MIN 4	/* shorter $(SEARCH)es are just walked */
+
+typedef struct _sindex SINDEX;
+
+struct _sindex {
+	char	*name;		/* the $(SEARCH) directories, joined */
+	LIST	*search;	/* the $(SEARCH) itself */
+	int	count;		/* directories in it */
+	struct hash *files;	/* SFILEs */
+} ;
+
+typedef struct _sfile SFILE;
+
+struct _sfile {
+	char	*name;		/* file name, without directory */
+	int	dir;		/* first $(SEARCH) directory it's in */
+} ;
+
+static struct hash *sindexes = 0;
+static SINDEX *sindexlast = 0;		/* the one last used */
+
+static int search_skip();
+static SINDEX *search_index();
+
+/*
+ * search() - find a target, returning its bound name and time
  */
 
 char *
@@ -52,6 +97,11 @@ time_t	*time;
 	}
 	else if( varlist = var_get( "SEARCH" ) )
 	{
+	    int skip = search_skip( varlist, f );
+
+	    while( skip-- && varlist )
+		varlist = list_next( varlist );
+
 	    while( varlist )
 	    {
 		f->f_root.ptr = varlist->string;
@@ -87,3 +137,206 @@ time_t	*time;
 
 	return newstr( buf );
 }
+
+/*
+ * search_skip() - count the $(SEARCH) directories a file isn't in
+ *
+ * Returns 0 if the file can't be looked up in an index (because it
+ * has a directory of its own, or the $(SEARCH) is short); else the 
+ * number of directories search() can pass by, which is all of them
+ * if the file is in none.
+ */
+
+static int
+search_skip( varlist, f )
+LIST	*varlist;
+FILENAME *f;
+{
+	SINDEX	*x;
+	SFILE	sfile, *s = &sfile;
+	char	buf[ MAXJPATH ];
+
+	if( f->f_dir.len || f->f_member.len )
+	    return 0;
+
+	if( !( x = search_index( varlist ) ) )
+	    return 0;
+
+	file_build( f, buf, 0 );
+	s->name = buf;
+
+	if( hashcheck( x->files, (HASHDATA **)&s ) )
+	    return s->dir;
+
+	return x->count;
+}
+
+/*
+ * search_index() - index the files along a $(SEARCH)
+ *
+ * Returns 0 if the $(SEARCH) is too short to bother.
+ *
+ * A file is indexed under its name only if search() would bind it to
+ * the very name timestamp() found it by, so the index can't find a
+ * file search() wouldn't.
+ */
+
+static SINDEX *
+search_index( varlist )
+LIST	*varlist;
+{
+	SINDEX	sindex, *x = &sindex;
+	SFILE	sfile, *s;
+	FILENAME f[1], g[1];
+	LIST	*l, *m;
+	char	*key, *k;
+	char	base[ MAXJPATH ];
+	char	buf[ MAXJPATH ];
+	int	len, dir;
+
+	/* Most likely it's the same $(SEARCH) as last time. */
+
+	if( sindexlast )
+	{
+	    for( l = varlist, m = sindexlast->search; l && m; )
+	    {
+		if( l->string != m->string )
+		    break;
+		l = list_next( l );
+		m = list_next( m );
+	    }
+
+	    if( !l && !m )
+		return sindexlast;
+	}
+
+	/* Look it up by its directories, joined. */
+
+	for( len = 1, dir = 0, l = varlist; l; l = list_next( l ), dir++ )
+	    len += strlen( l->string ) + 1;
+
+	if( dir < SEARCH_INDEX_MIN )
+	    return 0;
+
+	key = k = (char *)malloc( len );
+
+	for( l = varlist; l; l = list_next( l ) )
+	{
+	    strcpy( k, l->string );
+	    k += strlen( k );
+	    *k++ = '\n';
+	}
+
+	*k = '\0';
+
+	if( !sindexes )
+	    sindexes = hashinit( sizeof( SINDEX ), "search indexes" );
+
+	x->name = key;
+
+	if( !hashenter( sindexes, (HASHDATA **)&x ) )
+	{
+	    free( key );
+	    return sindexlast = x;
+	}
+
+	x->name = newstr( key );
+	x->search = list_copy( L0, varlist );
+	x->count = dir;
+	x->files = hashinit( sizeof( SFILE ), "search index" );
+
+	free( key );
+
+	/* Enter each file of each directory, unless an earlier */
+	/* directory has it. */
+
+	for( dir = 0, l = varlist; l; l = list_next( l ), dir++ )
+	{
+	    memset( (char *)f, '\0', sizeof( *f ) );
+	    f->f_root.ptr = l->string;
+	    f->f_root.len = strlen( l->string );
+	    f->f_base.ptr = "x";
+	    f->f_base.len = 1;
+
+	    file_build( f, buf, 1 );
+
+	    for( m = timestamp_dir( buf ); m; m = list_next( m ) )
+	    {
+		file_parse( m->string, g );
+
+		if( g->f_member.len )
+		    continue;
+
+		g->f_grist.len = 0;
+		g->f_dir.len = 0;
+		file_build( g, base, 0 );
+
+		f->f_base.ptr = base;
+		f->f_base.len = strlen( base );
+		file_build( f, buf, 1 );
+
+		if( strcmp( buf, m->string ) )
+		    continue;
+
+		s = &sfile;
+		s->name = base;
+
+		if( hashenter( x->files, (HASHDATA **)&s ) )
+		{
+		    s->name = newstr( base );
+		    s->dir = dir;
+		}
+	    }
+	}
+
+	return sindexlast = x;
+}
+
+/*
+ * search_prefetch() - start scanning where search() will look
+ *
+ * Hands each directory along $(LOCATE) or $(SEARCH) to
+ * timestamp_prefetch(), so that they are scanned (with -j) by the
+ * time search() gets to them.
+ */
+
+void
+search_prefetch( target )
+char	*target;
+{
+	FILENAME f[1];
+	LIST	*varlist;
+	char	buf[ MAXJPATH ];
+
+	file_parse( target, f );
+
+	f->f_grist.ptr = 0;
+	f->f_grist.len = 0;
+
+	if( varlist = var_get( "LOCATE" ) )
+	{
+	    f->f_root.ptr = varlist->string;
+	    f->f_root.len = strlen( varlist->string );
+
+	    file_build( f, buf, 1 );
+	    timestamp_prefetch( buf );
+
+	    return;
+	}
+
+	for( varlist = var_get( "SEARCH" ); varlist; 
+	     varlist = list_next( varlist ) )
+	{
+	    f->f_root.ptr = varlist->string;
+	    f->f_root.len = strlen( varlist->string );
+
+	    file_build( f, buf, 1 );
+	    timestamp_prefetch( buf );
+	}
+
+	f->f_root.ptr = 0;
+	f->f_root.len = 0;
+
+	file_build( f, buf, 1 );
+	timestamp_prefetch( buf );
+}
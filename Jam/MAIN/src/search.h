@@ -9,3 +9,4 @@
  */
 
 char *search();
+void search_prefetch();
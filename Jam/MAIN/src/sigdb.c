@@ -0,0 +1,525 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "parse.h"
+# include "variable.h"
+# include "rules.h"
+# include "hash.h"
+# include "newstr.h"
+# include "md5.h"
+# include "sigdb.h"
+
+/*
+ * sigdb.c - judge targets by the content of their inputs
+ *
+ * If $(SIGFILE) names a file, it holds a signature (an MD5 digest)
+ * of the inputs of each target, as they were when the target was last
+ * built.  A target that is older than its inputs, but whose inputs'
+ * signature is the same as when it was built, needn't be built again:
+ * its inputs were only touched, or changed and changed back.  That
+ * holds only while the target is the file built then, so its time and
+ * size are kept too: one rebuilt since by other means is judged by
+ * time as usual.
+ *
+ * A target's inputs are the files it depends on, the headers those
+ * include, and so on; NOTFILE targets, and targets that aren't files
+ * of their own (like archive members), stand for what they depend on.
+ * The signature covers the name and the content of each.
+ *
+ * Summing a file's content means reading it, so the file also holds
+ * the digest of each file summed, with its modification time and
+ * size: while these are unchanged, the file isn't read again.
+ *
+ * Make1() also asks whether a target it updated came out the same as
+ * it was before, so as to leave alone the targets that depend on it.
+ *
+ * The file starts with a version line, and then has one line per
+ * file or target:
+ *
+ *	<age> <time> <size> <file digest> <inputs digest>
+ *		<target time> <target size> <name>
+ *
+ * A digest is "-" if unknown.  <age> counts the runs since the entry
+ * was last used, as in the header cache (see hcache.c).
+ *
+ * External routines:
+ *
+ *	sigdb_check() - are a target's inputs as when it was last built?
+ *	sigdb_known() - is there a signature for a target's inputs?
+ *	sigdb_set() - remember the signature of a target's inputs
+ *	sigdb_mark() - note a target's content before it is updated
+ *	sigdb_same() - is an updated target's content as before?
+ *	sigdb_file() - get the digest of a file's content
+ *	sigdb_inputs() - get the digest of a target's inputs
+ *	sigdb_done() - write the signature file back, if anything changed
+ *
+ * Sigdb_file() and sigdb_inputs() work without $(SIGFILE) too, for
+ * the action cache (see acache.c): digests are then only kept for the
+ * one run.
+ *
+ * Internal routines:
+ *
+ *	sigdb_init() - read the signature file named by $(SIGFILE)
+ *	sigdb_get() - find or make the entry for a name
+ *	sigdb_add() - add a target (and what it includes) to a digest
+ *	sigdb_hex() - finish a digest, in hex
+ */
+
+# define SIGDB_VERSION "# jam signatures 2\n"
+# define SIGDB_MAXAGE 100
+# define SIGDB_HEX ( 2 * MD5_SIZE + 1 )
+
+typedef struct _sig SIG;
+
+struct _sig {
+	char	*name;		/* bound name of the file or target */
+	int	age;		/* runs since last used */
+	time_t	time;		/* of the file when summed */
+	long	size;
+	char	file[ SIGDB_HEX ];	/* digest of the file, or "" */
+	char	inputs[ SIGDB_HEX ];	/* digest of the target's inputs */
+	time_t	built;		/* of the target, when inputs was set */
+	long	bsize;
+	char	old[ SIGDB_HEX ];	/* sigdb_mark()'s digest, or "" */
+	SIG	*next;		/* for sigdb_done() */
+} ;
+
+static struct hash *sigdbhash = 0;
+static SIG *sigdblist = 0;
+static char *sigdbfile = 0;
+static int sigdbdirty = 0;
+
+static int sigdb_init();
+static SIG *sigdb_get();
+static void sigdb_add();
+static void sigdb_hex();
+
+/*
+ * sigdb_init() - read the signature file named by $(SIGFILE)
+ *
+ * Returns 0 if $(SIGFILE) isn't set.
+ */
+
+static int
+sigdb_init()
+{
+	LIST	*l;
+	FILE	*f;
+	char	buf[ MAXJPATH + 128 ];
+	char	file[ SIGDB_HEX ], inputs[ SIGDB_HEX ];
+	SIG	*s;
+	int	age, n;
+	long	time, size, built, bsize;
+
+	if( sigdbfile )
+	    return 1;
+
+	if( !( l = var_get( "SIGFILE" ) ) )
+	    return 0;
+
+	sigdbfile = l->string;
+
+	if( !( f = fopen( sigdbfile, "r" ) ) )
+	    return 1;
+
+	if( !fgets( buf, sizeof( buf ), f ) || strcmp( buf, SIGDB_VERSION ) )
+	{
+	    printf( "warning: ignoring signature file %s\n", sigdbfile );
+	    fclose( f );
+	    return 1;
+	}
+
+	while( fgets( buf, sizeof( buf ), f ) && strchr( buf, '\n' ) )
+	{
+	    if( sscanf( buf, "%d %ld %ld %32s %32s %ld %ld %n",
+			&age, &time, &size, file, inputs,
+			&built, &bsize, &n ) < 7 )
+		break;
+
+	    buf[ strlen( buf ) - 1 ] = '\0';
+
+	    s = sigdb_get( buf + n );
+	    s->age = age;
+	    s->time = time;
+	    s->size = size;
+	    s->built = built;
+	    s->bsize = bsize;
+	    strcpy( s->file, strcmp( file, "-" ) ? file : "" );
+	    strcpy( s->inputs, strcmp( inputs, "-" ) ? inputs : "" );
+	}
+
+	fclose( f );
+
+	if( DEBUG_MAKEPROG )
+	    printf( "read signatures from %s\n", sigdbfile );
+
+	return 1;
+}
+
+/*
+ * sigdb_get() - find or make the entry for a name
+ */
+
+static SIG *
+sigdb_get( name )
+char	*name;
+{
+	SIG	sig, *s = &sig;
+
+	if( !sigdbhash )
+	    sigdbhash = hashinit( sizeof( SIG ), "signatures" );
+
+	s->name = name;
+
+	if( hashenter( sigdbhash, (HASHDATA **)&s ) )
+	{
+	    s->name = newstr( name );
+	    s->time = 0;
+	    s->size = -1;
+	    s->file[0] = '\0';
+	    s->inputs[0] = '\0';
+	    s->built = 0;
+	    s->bsize = -1;
+	    s->old[0] = '\0';
+	    s->next = sigdblist;
+	    sigdblist = s;
+	}
+	else if( s->age > 1 )
+	{
+	    sigdbdirty = 1;
+	}
+
+	s->age = 0;
+
+	return s;
+}
+
+/*
+ * sigdb_check() - are a target's inputs as when it was last built?
+ */
+
+int
+sigdb_check( t )
+TARGET	*t;
+{
+	char	inputs[ SIGDB_HEX ];
+	struct stat statbuf;
+	SIG	*s;
+
+	if( !sigdb_init() || t->flags & T_FLAG_NOTFILE )
+	    return 0;
+
+	s = sigdb_get( t->boundname );
+
+	if( !s->inputs[0] )
+	    return 0;
+
+	/* Is the target still the one built from them? */
+
+	if( stat( t->boundname, &statbuf ) < 0 ||
+	    statbuf.st_mtime != s->built ||
+	    statbuf.st_size != s->bsize )
+		return 0;
+
+	sigdb_inputs( t, inputs );
+
+	if( strcmp( inputs, s->inputs ) )
+	    return 0;
+
+	if( DEBUG_MAKEPROG )
+	    printf( "sigs\t--\t%s: inputs unchanged\n", t->name );
+
+	return 1;
+}
+
+/*
+ * sigdb_known() - is there a signature for a target's inputs?
+ */
+
+int
+sigdb_known( t )
+TARGET	*t;
+{
+	if( !sigdb_init() || t->flags & T_FLAG_NOTFILE )
+	    return 0;
+
+	return sigdb_get( t->boundname )->inputs[0] != '\0';
+}
+
+/*
+ * sigdb_set() - remember the signature of a target's inputs
+ */
+
+void
+sigdb_set( t )
+TARGET	*t;
+{
+	struct stat statbuf;
+	SIG	*s;
+
+	if( !sigdb_init() || t->flags & T_FLAG_NOTFILE )
+	    return;
+
+	s = sigdb_get( t->boundname );
+
+	if( stat( t->boundname, &statbuf ) < 0 )
+	{
+	    s->inputs[0] = '\0';
+	}
+	else
+	{
+	    sigdb_inputs( t, s->inputs );
+	    s->built = statbuf.st_mtime;
+	    s->bsize = statbuf.st_size;
+	}
+
+	sigdbdirty = 1;
+}
+
+/*
+ * sigdb_mark() - note a target's content before it is updated
+ */
+
+void
+sigdb_mark( t )
+TARGET	*t;
+{
+	SIG	*s;
+
+	if( !sigdb_init() || t->flags & T_FLAG_NOTFILE )
+	    return;
+
+	s = sigdb_get( t->boundname );
+
+	if( !sigdb_file( t->boundname, s->old ) )
+	    s->old[0] = '\0';
+}
+
+/*
+ * sigdb_same() - is an updated target's content as before?
+ *
+ * Compares it with what sigdb_mark() found.
+ */
+
+int
+sigdb_same( t )
+TARGET	*t;
+{
+	char	file[ SIGDB_HEX ];
+	SIG	*s;
+
+	if( !sigdb_init() || t->flags & T_FLAG_NOTFILE )
+	    return 0;
+
+	s = sigdb_get( t->boundname );
+
+	return s->old[0] &&
+		sigdb_file( t->boundname, file ) &&
+		!strcmp( file, s->old );
+}
+
+/*
+ * sigdb_inputs() - get the digest of a target's inputs
+ */
+
+void
+sigdb_inputs( t, hex )
+TARGET	*t;
+char	*hex;
+{
+	struct hash *seen = hashinit( sizeof( char * ), "signed" );
+	TARGETS	*c;
+	MD5	m;
+
+	md5_init( &m );
+
+	for( c = t->deps[ T_DEPS_DEPENDS ]; c; c = c->next )
+	    sigdb_add( c->target, &m, seen );
+
+	hashdone( seen );
+
+	sigdb_hex( &m, hex );
+}
+
+/*
+ * sigdb_add() - add a target (and what it includes) to a digest
+ */
+
+static void
+sigdb_add( t, m, seen )
+TARGET	*t;
+MD5	*m;
+struct hash *seen;
+{
+	char	*name = t->boundname ? t->boundname : t->name;
+	char	file[ SIGDB_HEX ];
+	char	**p = &t->name;
+	TARGETS	*c;
+
+	if( !hashenter( seen, (HASHDATA **)&p ) )
+	    return;
+
+	if( t->flags & T_FLAG_NOTFILE )
+	{
+	    for( c = t->deps[ T_DEPS_DEPENDS ]; c; c = c->next )
+		sigdb_add( c->target, m, seen );
+	}
+	else if( sigdb_file( name, file ) )
+	{
+	    md5_update( m, (unsigned char *)name, strlen( name ) + 1 );
+	    md5_update( m, (unsigned char *)file, strlen( file ) + 1 );
+	}
+	else
+	{
+	    /* Not a file of its own (an archive member, say, or not */
+	    /* made yet): it stands for what it depends on, if anything. */
+
+	    md5_update( m, (unsigned char *)name, strlen( name ) + 1 );
+
+	    if( !t->deps[ T_DEPS_DEPENDS ] )
+		md5_update( m, (unsigned char *)"-", 2 );
+
+	    for( c = t->deps[ T_DEPS_DEPENDS ]; c; c = c->next )
+		sigdb_add( c->target, m, seen );
+	}
+
+	for( c = t->deps[ T_DEPS_INCLUDES ]; c; c = c->next )
+	    sigdb_add( c->target, m, seen );
+}
+
+/*
+ * sigdb_file() - get the digest of a file's content
+ *
+ * Returns 0 if the file isn't there.  A digest is reused only while
+ * the file's time and size are the same, and not if the file changed
+ * within the second it was summed (it could change again unseen).
+ */
+
+int
+sigdb_file( name, hex )
+char	*name;
+char	*hex;
+{
+	struct stat statbuf;
+	unsigned char buf[ 8192 ];
+	FILE	*f;
+	SIG	*s;
+	MD5	m;
+	int	n;
+
+	if( stat( name, &statbuf ) < 0 )
+	    return 0;
+
+	s = sigdb_get( name );
+
+	if( s->file[0] &&
+	    s->time == statbuf.st_mtime &&
+	    s->size == statbuf.st_size )
+	{
+	    strcpy( hex, s->file );
+	    return 1;
+	}
+
+	if( !( f = fopen( name, "rb" ) ) )
+	    return 0;
+
+	md5_init( &m );
+
+	while( ( n = fread( buf, 1, sizeof( buf ), f ) ) > 0 )
+	    md5_update( &m, buf, n );
+
+	fclose( f );
+
+	sigdb_hex( &m, hex );
+
+	if( statbuf.st_mtime < time( (time_t *)0 ) - 1 )
+	{
+	    s->time = statbuf.st_mtime;
+	    s->size = statbuf.st_size;
+	    strcpy( s->file, hex );
+	    sigdbdirty = 1;
+	}
+
+	return 1;
+}
+
+/*
+ * sigdb_hex() - finish a digest, in hex
+ */
+
+static void
+sigdb_hex( m, hex )
+MD5	*m;
+char	*hex;
+{
+	unsigned char digest[ MD5_SIZE ];
+	int	i;
+
+	md5_final( m, digest );
+
+	for( i = 0; i < MD5_SIZE; i++ )
+	    sprintf( hex + 2 * i, "%02x", digest[i] );
+}
+
+/*
+ * sigdb_done() - write the signature file back, if anything changed
+ */
+
+void
+sigdb_done()
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	SIG	*s;
+
+	/* Entries not used this run have aged, even if none was; */
+	/* those used again go back to age 1. */
+
+	sigdb_init();
+
+	for( s = sigdblist; s; s = s->next )
+	    if( s->age )
+		sigdbdirty = 1;
+
+	if( !sigdbfile || !sigdbdirty )
+	    return;
+
+	if( strlen( sigdbfile ) + 5 > MAXJPATH )
+	    return;
+
+	sprintf( tmp, "%s.new", sigdbfile );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "can't write signature file %s\n", tmp );
+	    return;
+	}
+
+	fputs( SIGDB_VERSION, f );
+
+	for( s = sigdblist; s; s = s->next )
+	{
+	    if( !s->file[0] && !s->inputs[0] || s->age >= SIGDB_MAXAGE )
+		continue;
+
+	    if( strchr( s->name, '\n' ) )
+		continue;
+
+	    fprintf( f, "%d %ld %ld %s %s %ld %ld %s\n",
+		s->age + 1, (long)s->time, s->size,
+		s->file[0] ? s->file : "-",
+		s->inputs[0] ? s->inputs : "-",
+		(long)s->built, s->bsize,
+		s->name );
+	}
+
+	if( fclose( f ) || rename( tmp, sigdbfile ) )
+	    printf( "can't write signature file %s\n", sigdbfile );
+
+	sigdbdirty = 0;
+}
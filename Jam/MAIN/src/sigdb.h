@@ -0,0 +1,18 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * sigdb.h - judge targets by the content of their inputs
+ */
+
+int sigdb_check();
+int sigdb_known();
+void sigdb_set();
+void sigdb_mark();
+int sigdb_same();
+int sigdb_file();
+void sigdb_inputs();
+void sigdb_done();
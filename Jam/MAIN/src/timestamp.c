@@ -6,6 +6,7 @@
 
 # include "jam.h"
 # include "hash.h"
+# include "lists.h"
 # include "filesys.h"
 #ifdef FATFS
 # include "timestam.h"
@@ -13,11 +14,45 @@
 # include "timestamp.h"
 #endif
 # include "newstr.h"
+# include "tpool.h"
+# include "dcache.h"
 
 /*
  * timestamp.c - get the timestamp of a file or archive member
+ *
+ * With -j, timestamp_prefetch() hands the directory of a file jam
+ * will want the timestamp of to a thread of the pool (see tpool.c),
+ * to be scanned and its files stat()'ed there.  When timestamp()
+ * then needs that directory scanned, it takes the results the job
+ * collected instead.  On a slow (networked) file system the round
+ * trips for many directories then overlap.
+ *
+ * If $(DIRCACHEFILE) is set, directories whose modification time is
+ * unchanged since they were last scanned aren't scanned again: the
+ * names of their files come from the cache instead (see dcache.c).
+ *
+ * External routines:
+ *
+ *	timestamp() - return timestamp on a file, if present
+ *	timestamp_dir() - scan the directory of a file, and list its files
+ *	timestamp_prefetch() - start scanning the directory of a file
+ *	donestamps() - free timestamp tables
+ *
+ * Internal routines:
+ *
+ *	time_enter() - note a file found by a directory scan
+ *	time_dirscan() - scan a directory, if not already done so
+ *	time_dircache() - enter a directory's files from the cache
+ *	time_dirjob() - scan a directory, on a thread of the pool
+ *	time_dirfile() - collect a file found by time_dirjob()
  */
 
+# ifdef unix
+# define TIME_PREFETCH
+# endif
+
+typedef struct _dirjob DIRJOB;
+
 /*
  * BINDING - all known files
  */
@@ -39,10 +74,41 @@ struct _binding {
 # define BIND_FOUND	4	/* file found and time stamped */
 
 	time_t	time;		/* update time - 0 if not exist */
+	DIRJOB	*job;		/* if directory, being scanned on the pool */
+	LIST	*files;		/* if directory, what's in it */
+} ;
+
+/*
+ * DIRJOB - a directory being scanned on the pool
+ *
+ * The files found are kept in names[], one after the other, with
+ * the timestamps of those stat()'ed in files[].
+ */
+
+struct _dirjob {
+	TJOB	job;
+	char	*dir;
+	time_t	time;		/* of dir, for dcache_put() */
+	char	*names;
+	int	len, size;
+	struct dirfile {
+		int	found;
+		time_t	time;
+	} *files;
+	int	count, max;
 } ;
 
 static struct hash *bindhash = 0;
 static void time_enter();
+static BINDING *time_dirscan();
+static int time_dircache();
+
+static int time_collect = 0;	/* time_enter() adds to time_files */
+static LIST *time_files = 0;
+# ifdef TIME_PREFETCH
+static void time_dirjob();
+static void time_dirfile();
+# endif
 
 static char *time_progress[] =
 {
@@ -85,6 +151,8 @@ time_t	*time;
 	b->name = target;
 	b->time = b->flags = 0;
 	b->progress = BIND_INIT;
+	b->job = 0;
+	b->files = 0;
 
 	if( hashenter( bindhash, (HASHDATA **)&b ) )
 	    b->name = newstr( target );		/* never freed */
@@ -100,27 +168,12 @@ time_t	*time;
 
 	/* Scan directory if not already done so */
 
-	{
-	    BINDING binding, *b = &binding;
-
-	    f2 = f1;
-	    f2.f_grist.len = 0;
-	    file_parent( &f2 );
-	    file_build( &f2, buf, 0 );
-
-	    b->name = buf;
-	    b->time = b->flags = 0;
-	    b->progress = BIND_INIT;
+	f2 = f1;
+	f2.f_grist.len = 0;
+	file_parent( &f2 );
+	file_build( &f2, buf, 0 );
 
-	    if( hashenter( bindhash, (HASHDATA **)&b ) )
-		b->name = newstr( buf );	/* never freed */
-
-	    if( !( b->flags & BIND_SCANNED ) )
-	    {
-		file_dirscan( buf, time_enter );
-		b->flags |= BIND_SCANNED;
-	    }
-	}
+	time_dirscan( buf );
 
 	/* Scan archive if not already done so */
 
@@ -136,6 +189,8 @@ time_t	*time;
 	    b->name = buf;
 	    b->time = b->flags = 0;
 	    b->progress = BIND_INIT;
+	    b->job = 0;
+	    b->files = 0;
 
 	    if( hashenter( bindhash, (HASHDATA **)&b ) )
 		b->name = newstr( buf );	/* never freed */
@@ -160,6 +215,282 @@ time_t	*time;
 	*time = b->progress == BIND_FOUND ? b->time : 0;
 }
 
+/*
+ * timestamp_dir() - scan the directory of a file, and list its files
+ *
+ * Returns the names of the files in the directory where timestamp()
+ * would look for target, as timestamp() would look them up.  The 
+ * LIST is timestamp()'s own, not a copy.
+ */
+
+LIST *
+timestamp_dir( target )
+char	*target;
+{
+	FILENAME f;
+	char buf[ MAXJPATH ];
+
+#if defined( NT ) || defined( VMS )
+	char path[ MAXJPATH ];
+	char *p = path;
+
+	do *p++ = tolower( *target );
+	while( *target++ );
+
+	target = path;
+#endif /* NT or VMS */
+
+	if( !bindhash )
+	    bindhash = hashinit( sizeof( BINDING ), "bindings" );
+
+	file_parse( target, &f );
+	f.f_grist.len = 0;
+	f.f_member.len = 0;
+	file_parent( &f );
+	file_build( &f, buf, 0 );
+
+	return time_dirscan( buf )->files;
+}
+
+/*
+ * timestamp_prefetch() - start scanning the directory of a file
+ *
+ * Does nothing unless -j, or if the directory is scanned (or being
+ * scanned) already.
+ */
+
+void
+timestamp_prefetch( target )
+char	*target;
+{
+# ifdef TIME_PREFETCH
+	FILENAME f;
+	BINDING	binding, *b = &binding;
+	DIRJOB	*job;
+	char buf[ MAXJPATH ];
+	time_t dirtime;
+
+	if( globs.jobs < 2 )
+	    return;
+
+	if( !bindhash )
+	    bindhash = hashinit( sizeof( BINDING ), "bindings" );
+
+	/* Timed already, so its directory has been scanned. */
+
+	b->name = target;
+
+	if( hashcheck( bindhash, (HASHDATA **)&b ) && 
+	    b->progress != BIND_INIT )
+		return;
+
+	file_parse( target, &f );
+	f.f_grist.len = 0;
+	f.f_member.len = 0;
+	file_parent( &f );
+	file_build( &f, buf, 0 );
+
+	b = &binding;
+	b->name = buf;
+	b->time = b->flags = 0;
+	b->progress = BIND_INIT;
+	b->job = 0;
+	b->files = 0;
+
+	if( hashenter( bindhash, (HASHDATA **)&b ) )
+	    b->name = newstr( buf );	/* never freed */
+
+	if( b->flags & BIND_SCANNED || b->job )
+	    return;
+
+	/* Unchanged since last run: no need to scan it at all. */
+
+	if( time_dircache( buf, &dirtime ) )
+	{
+	    b->flags |= BIND_SCANNED;
+	    return;
+	}
+
+	if( !tpool_init( globs.jobs, 4 * globs.jobs ) )
+	    return;
+
+	job = (DIRJOB *)malloc( sizeof( DIRJOB ) );
+	job->job.func = time_dirjob;
+	job->dir = b->name;
+	job->time = dirtime;
+	job->names = 0;
+	job->len = job->size = 0;
+	job->files = 0;
+	job->count = job->max = 0;
+
+	if( !tpool_submit( &job->job ) )
+	{
+	    free( (char *)job );
+	    return;
+	}
+
+	b->job = job;
+# endif
+}
+
+# ifdef TIME_PREFETCH
+
+/*
+ * time_dirjob() - scan a directory, on a thread of the pool
+ */
+
+static void
+time_dirjob( tjob )
+TJOB	*tjob;
+{
+	DIRJOB	*job = (DIRJOB *)tjob;
+
+	file_dirscan_r( job->dir, time_dirfile, (void *)job );
+}
+
+/*
+ * time_dirfile() - collect a file found by time_dirjob()
+ */
+
+static void
+time_dirfile( arg, filename, found, time )
+void	*arg;
+char	*filename;
+int	found;
+time_t	time;
+{
+	DIRJOB	*job = (DIRJOB *)arg;
+	int	l = strlen( filename ) + 1;
+
+	while( job->len + l > job->size )
+	{
+	    job->size = job->size ? 2 * job->size : 1024;
+	    job->names = (char *)realloc( job->names, job->size );
+	}
+
+	if( job->count == job->max )
+	{
+	    job->max = job->max ? 2 * job->max : 32;
+	    job->files = (struct dirfile *)realloc( (char *)job->files, 
+			job->max * sizeof( struct dirfile ) );
+	}
+
+	memcpy( job->names + job->len, filename, l );
+	job->len += l;
+	job->files[ job->count ].found = found;
+	job->files[ job->count ].time = time;
+	job->count++;
+}
+
+# endif /* TIME_PREFETCH */
+
+/*
+ * time_dirscan() - scan a directory, if not already done so
+ *
+ * Its files are entered from the cache (if it's unchanged), from a
+ * job on the pool (if timestamp_prefetch() started one), or by
+ * file_dirscan(); and listed in the directory's own BINDING.
+ */
+
+static BINDING *
+time_dirscan( dir )
+char	*dir;
+{
+	BINDING	binding, *b = &binding;
+	time_t	dirtime;
+
+	b->name = dir;
+	b->time = b->flags = 0;
+	b->progress = BIND_INIT;
+	b->job = 0;
+	b->files = 0;
+
+	if( hashenter( bindhash, (HASHDATA **)&b ) )
+	    b->name = newstr( dir );	/* never freed */
+
+	if( b->flags & BIND_SCANNED )
+	    return b;
+
+	time_collect = 1;
+	time_files = 0;
+
+	if( b->job )
+	{
+	    DIRJOB	*job = b->job;
+	    char	*name;
+	    int		i;
+
+	    /* Take what the pool found. */
+
+	    tpool_wait( &job->job );
+	    name = job->names;
+
+	    if( DEBUG_BINDSCAN && job->count )
+		printf( "scan directory %s\n", *dir ? dir : "." );
+
+	    for( i = 0; i < job->count; name += strlen( name ) + 1, i++ )
+		time_enter( name, job->files[i].found, job->files[i].time );
+
+	    if( dcache_init() )
+		dcache_put( dir, job->time, list_copy( L0, time_files ) );
+
+	    free( job->names );
+	    free( (char *)job->files );
+	    free( (char *)job );
+	    b->job = 0;
+	}
+	else if( !time_dircache( dir, &dirtime ) )
+	{
+	    file_dirscan( dir, time_enter );
+
+	    if( dcache_init() )
+		dcache_put( dir, dirtime, list_copy( L0, time_files ) );
+	}
+
+	b->files = time_files;
+	b->flags |= BIND_SCANNED;
+
+	time_collect = 0;
+	time_files = 0;
+
+	return b;
+}
+
+/*
+ * time_dircache() - enter a directory's files from the cache
+ *
+ * Returns 1 if the cached names are still good, else 0.  Either way
+ * *dirtime is set to the directory's time (0 without a cache), for
+ * dcache_put() after a scan.
+ */
+
+static int
+time_dircache( dir, dirtime )
+char	*dir;
+time_t	*dirtime;
+{
+	LIST	*l;
+
+	*dirtime = 0;
+
+	if( !dcache_init() || 
+	    file_time( *dir ? dir : ".", dirtime ) < 0 ||
+	    !( l = dcache_get( dir, *dirtime ) ) )
+		return 0;
+
+	if( DEBUG_BINDSCAN )
+	    printf( "cached directory %s\n", *dir ? dir : "." );
+
+	for( ; l; l = list_next( l ) )
+	    time_enter( l->string, 0 /* not stat()'ed */, (time_t)0 );
+
+	return 1;
+}
+
+/*
+ * time_enter() - note a file found by a directory scan
+ */
+
 static void
 time_enter( target, found, time )
 char	*target;
@@ -180,6 +511,8 @@ time_t	time;
 
 	b->name = target;
 	b->flags = 0;
+	b->job = 0;
+	b->files = 0;
 
 	if( hashenter( bindhash, (HASHDATA **)&b ) )
 	    b->name = newstr( target );		/* never freed */
@@ -187,6 +520,9 @@ time_t	time;
 	b->time = time;
 	b->progress = found ? BIND_FOUND : BIND_SPOTTED;
 
+	if( time_collect )
+	    time_files = list_new( time_files, b->name );
+
 	if( DEBUG_BINDSCAN )
 	    printf( "time ( %s ) : %s\n", target, time_progress[b->progress] );
 }
@@ -9,5 +9,7 @@
  */
 
 void timestamp();
+LIST *timestamp_dir();
+void timestamp_prefetch();
 void donestamps();
 
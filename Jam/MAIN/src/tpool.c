@@ -0,0 +1,194 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "tpool.h"
+
+# ifdef unix
+# include <unistd.h>
+# endif
+
+# if defined( unix ) && defined( _POSIX_THREADS )
+# include <pthread.h>
+# define TPOOL_THREADS
+# endif
+
+/*
+ * tpool.c - a pool of threads to run jobs off the main thread
+ *
+ * The main thread submits jobs to a bounded queue, from which the
+ * pool's threads take and run them, and later waits for each job to
+ * be done before using its results.
+ *
+ * Nothing of jam's -- strings, lists, hashes, variables -- is safe to
+ * use from a pool thread, so a job's func must work only on what the
+ * main thread handed it, leaving its results in the job.
+ *
+ * Without threads, tpool_init() fails and callers do the work
+ * themselves.
+ *
+ * External routines:
+ *
+ *	tpool_init() - start the pool's threads
+ *	tpool_submit() - queue a job, waiting for room in the queue
+ *	tpool_wait() - wait for a job to be done
+ *
+ * Internal routines:
+ *
+ *	tpool_thread() - take jobs off the queue and run them
+ */
+
+# ifdef TPOOL_THREADS
+
+static pthread_mutex_t tpool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tpool_work = PTHREAD_COND_INITIALIZER;	/* queued */
+static pthread_cond_t tpool_room = PTHREAD_COND_INITIALIZER;	/* dequeued */
+static pthread_cond_t tpool_done = PTHREAD_COND_INITIALIZER;	/* done */
+
+static TJOB *tpool_head = 0;	/* the queue */
+static TJOB *tpool_tail = 0;
+static int tpool_queued = 0;
+static int tpool_max = 0;	/* most jobs queued at once */
+
+static int tpool_threads = 0;
+
+static void *tpool_thread();
+
+# endif
+
+/*
+ * tpool_init() - start the pool's threads
+ *
+ * Returns the number of threads running, or 0 if there are none:
+ * callers must then do their own work.
+ */
+
+int
+tpool_init( threads, max )
+int	threads;
+int	max;
+{
+# ifdef TPOOL_THREADS
+	pthread_t thread;
+
+	if( tpool_threads )
+	    return tpool_threads;
+
+	tpool_max = max;
+
+	for( ; tpool_threads < threads; tpool_threads++ )
+	{
+	    if( pthread_create( &thread, (pthread_attr_t *)0, 
+			tpool_thread, (void *)0 ) )
+		break;
+
+	    pthread_detach( thread );
+	}
+
+	return tpool_threads;
+# else
+	return 0;
+# endif
+}
+
+/*
+ * tpool_submit() - queue a job, waiting for room in the queue
+ *
+ * Returns 0 if there's no pool to run it.
+ */
+
+int
+tpool_submit( job )
+TJOB	*job;
+{
+# ifdef TPOOL_THREADS
+	if( !tpool_threads )
+	    return 0;
+
+	job->next = 0;
+	job->done = 0;
+
+	pthread_mutex_lock( &tpool_lock );
+
+	while( tpool_queued >= tpool_max )
+	    pthread_cond_wait( &tpool_room, &tpool_lock );
+
+	if( tpool_tail )
+	    tpool_tail->next = job;
+	else
+	    tpool_head = job;
+
+	tpool_tail = job;
+	tpool_queued++;
+
+	pthread_cond_signal( &tpool_work );
+	pthread_mutex_unlock( &tpool_lock );
+
+	return 1;
+# else
+	return 0;
+# endif
+}
+
+/*
+ * tpool_wait() - wait for a job to be done
+ */
+
+void
+tpool_wait( job )
+TJOB	*job;
+{
+# ifdef TPOOL_THREADS
+	pthread_mutex_lock( &tpool_lock );
+
+	while( !job->done )
+	    pthread_cond_wait( &tpool_done, &tpool_lock );
+
+	pthread_mutex_unlock( &tpool_lock );
+# endif
+}
+
+# ifdef TPOOL_THREADS
+
+/*
+ * tpool_thread() - take jobs off the queue and run them
+ */
+
+static void *
+tpool_thread( arg )
+void	*arg;
+{
+	TJOB	*job;
+
+	for(;;)
+	{
+	    pthread_mutex_lock( &tpool_lock );
+
+	    while( !tpool_head )
+		pthread_cond_wait( &tpool_work, &tpool_lock );
+
+	    job = tpool_head;
+
+	    if( !( tpool_head = job->next ) )
+		tpool_tail = 0;
+
+	    tpool_queued--;
+
+	    pthread_cond_signal( &tpool_room );
+	    pthread_mutex_unlock( &tpool_lock );
+
+	    (*job->func)( job );
+
+	    pthread_mutex_lock( &tpool_lock );
+	    job->done = 1;
+	    pthread_cond_broadcast( &tpool_done );
+	    pthread_mutex_unlock( &tpool_lock );
+	}
+
+	return (void *)0;
+}
+
+# endif
@@ -0,0 +1,23 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * tpool.h - a pool of threads to run jobs off the main thread
+ */
+
+typedef struct _tjob TJOB;
+
+/* TJOB - a job for the pool, the first member of the caller's struct */
+
+struct _tjob {
+	void	(*func)();		/* (*func)( job ), on a pool thread */
+	TJOB	*next;			/* on the pool's queue */
+	int	done;			/* (*func)() has returned */
+} ;
+
+int tpool_init();
+int tpool_submit();
+void tpool_wait();
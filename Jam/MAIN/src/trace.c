@@ -0,0 +1,261 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "execcmd.h"
+# include "trace.h"
+
+# ifdef unix
+# include <sys/time.h>
+# endif
+
+/*
+ * trace.c - record a build's timeline as Chrome trace events
+ *
+ * With -T file, jam writes to file a JSON array of trace events, as
+ * loaded by chrome://tracing and Perfetto:
+ *
+ *	- the parsing, binding and updating phases, on thread 0
+ *	- each file's header scan, on thread 0
+ *	- each action, on the thread of the job slot that ran it,
+ *	  with its targets, exit status and (if known) CPU time
+ *
+ * Events are written as they happen.  If jam dies, the array is
+ * left without its closing ], which the viewers don't mind.
+ *
+ * External routines:
+ *
+ *	trace_open() - start writing trace events to a file
+ *	trace_now() - the time, in seconds, if tracing
+ *	trace_begin() - note the start of a phase
+ *	trace_end() - note the end of a phase
+ *	trace_span() - note something on thread 0 that took since start
+ *	trace_action() - note an action that ran
+ *	trace_close() - finish the trace file
+ *
+ * Internal routines:
+ *
+ *	trace_event() - start writing an event
+ *	trace_string() - write a JSON string
+ *	trace_us() - convert a time to microseconds into the trace
+ */
+
+static FILE *tracef = 0;
+static double trace0;		/* trace_now() at trace_open() */
+static int traceslots = 0;	/* job slot threads named so far */
+
+static void trace_event();
+static void trace_string();
+static double trace_us();
+
+/*
+ * trace_open() - start writing trace events to a file
+ */
+
+void
+trace_open( file )
+char	*file;
+{
+	if( !( tracef = fopen( file, "w" ) ) )
+	{
+	    printf( "can't write trace file %s\n", file );
+	    exit( EXITBAD );
+	}
+
+	trace0 = trace_now();
+
+	fprintf( tracef, "[\n" );
+	fprintf( tracef, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1," );
+	fprintf( tracef, "\"tid\":0,\"args\":{\"name\":\"jam\"}}" );
+}
+
+/*
+ * trace_now() - the time, in seconds, if tracing
+ *
+ * Returns 0 if not, without asking the system.
+ */
+
+double
+trace_now()
+{
+# ifdef unix
+	struct timeval tv;
+# endif
+
+	if( !tracef )
+	    return 0;
+
+# ifdef unix
+	gettimeofday( &tv, (struct timezone *)0 );
+
+	return tv.tv_sec + tv.tv_usec / 1e6;
+# else
+	return (double)time( (time_t *)0 );
+# endif
+}
+
+/*
+ * trace_begin() - note the start of a phase
+ */
+
+void
+trace_begin( name )
+char	*name;
+{
+	if( !tracef )
+	    return;
+
+	trace_event( "phase", name, "B", 0, trace_now() );
+	fprintf( tracef, "}" );
+}
+
+/*
+ * trace_end() - note the end of a phase
+ */
+
+void
+trace_end( name )
+char	*name;
+{
+	if( !tracef )
+	    return;
+
+	trace_event( "phase", name, "E", 0, trace_now() );
+	fprintf( tracef, "}" );
+}
+
+/*
+ * trace_span() - note something on thread 0 that took since start
+ */
+
+void
+trace_span( cat, name, start )
+char	*cat;
+char	*name;
+double	start;
+{
+	if( !tracef )
+	    return;
+
+	trace_event( cat, name, "X", 0, start );
+	fprintf( tracef, ",\"dur\":%.0f}", trace_us( trace_now() ) - 
+		trace_us( start ) );
+}
+
+/*
+ * trace_action() - note an action that ran
+ */
+
+void
+trace_action( name, targets, status, info )
+char	*name;
+LIST	*targets;
+int	status;
+EXECINFO *info;
+{
+	if( !tracef || !info )
+	    return;
+
+	/* Name the job slot's thread the first time it's seen */
+
+	for( ; traceslots < info->slot; traceslots++ )
+	{
+	    fprintf( tracef, ",\n{\"name\":\"thread_name\",\"ph\":\"M\"," );
+	    fprintf( tracef, "\"pid\":1,\"tid\":%d,", traceslots + 1 );
+	    fprintf( tracef, "\"args\":{\"name\":\"job %d\"}}", traceslots + 1 );
+	}
+
+	trace_event( "action", name, "X", info->slot, info->start );
+	fprintf( tracef, ",\"dur\":%.0f", 
+		trace_us( info->end ) - trace_us( info->start ) );
+
+	fprintf( tracef, ",\"args\":{\"targets\":[" );
+
+	for( ; targets; targets = list_next( targets ) )
+	{
+	    trace_string( targets->string );
+
+	    if( list_next( targets ) )
+		fprintf( tracef, "," );
+	}
+
+	fprintf( tracef, "],\"exitcode\":%d,\"status\":%d",
+		info->exitcode, status );
+
+	if( info->user >= 0 )
+	    fprintf( tracef, ",\"user\":%.3f,\"sys\":%.3f,\"maxrss\":%ld",
+		info->user, info->sys, info->maxrss );
+
+	fprintf( tracef, "}}" );
+}
+
+/*
+ * trace_close() - finish the trace file
+ */
+
+void
+trace_close()
+{
+	if( !tracef )
+	    return;
+
+	fprintf( tracef, "\n]\n" );
+	fclose( tracef );
+	tracef = 0;
+}
+
+/*
+ * trace_event() - start writing an event
+ *
+ * The caller adds any other fields and the closing }.
+ */
+
+static void
+trace_event( cat, name, ph, tid, ts )
+char	*cat;
+char	*name;
+char	*ph;
+int	tid;
+double	ts;
+{
+	fprintf( tracef, ",\n{\"cat\":\"%s\",\"name\":", cat );
+	trace_string( name );
+	fprintf( tracef, ",\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.0f",
+		ph, tid, trace_us( ts ) );
+}
+
+/*
+ * trace_string() - write a JSON string
+ */
+
+static void
+trace_string( s )
+char	*s;
+{
+	putc( '"', tracef );
+
+	for( ; *s; s++ )
+	    if( *s == '"' || *s == '\\' )
+		fprintf( tracef, "\\%c", *s );
+	    else if( (unsigned char)*s < ' ' )
+		fprintf( tracef, "\\u%04x", *s );
+	    else
+		putc( *s, tracef );
+
+	putc( '"', tracef );
+}
+
+/*
+ * trace_us() - convert a time to microseconds into the trace
+ */
+
+static double
+trace_us( t )
+double	t;
+{
+	return ( t - trace0 ) * 1e6;
+}
@@ -0,0 +1,17 @@
+/*
+ * Copyright 1993, 1995 Christopher Seiwald.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * trace.h - record a build's timeline as Chrome trace events
+ */
+
+void trace_open();
+double trace_now();
+void trace_begin();
+void trace_end();
+void trace_span();
+void trace_action();
+void trace_close();
@@ -29,6 +29,7 @@
  * Internal routines:
  *
  *	var_enter() - make new var symbol table entry, returning var ptr
+ *	var_grow() - make room in a var_string() buffer
  *	var_dump() - dump a variable to stdout
  *
  * 04/13/94 (seiwald) - added shorthand L0 for null list pointer
@@ -52,6 +53,7 @@ struct _variable {
 
 static VARIABLE	*var_enter();
 static void	var_dump();
+static char	*var_grow();
 
 
 
@@ -135,82 +137,108 @@ LOL	*lol;
 /*
  * var_string() - expand a string with variables in it
  *
- * Copies in to out; doesn't modify targets & sources.
+ * Copies in to a newly malloc'ed buffer, growing it as the expansion
+ * proceeds, and returns it trimmed to the exact size.  If lenp is
+ * non-null, *lenp gets the length of the result (not counting the
+ * null).  Doesn't modify targets & sources.
  */
 
-int
-var_string( in, out, outsize, lol )
+# define VAR_STRING_INIT 256	/* first guess at result size */
+
+char *
+var_string( in, lol, lenp )
 char	*in;
-char	*out;
-int	outsize;
 LOL	*lol;
+int	*lenp;
 {
-	char 	*out0 = out;
-	char	*oute = out + outsize - 1;
+	int	size = VAR_STRING_INIT;
+	int	len = 0;
+	char	*out = (char *)malloc( size );
 
 	while( *in )
 	{
-	    char	*lastword;
+	    int		lastword;
 	    int		dollar = 0;
 
 	    /* Copy white space */
 
 	    while( isspace( *in ) )
 	    {
-		if( out >= oute )
-		    return -1;
+		if( len + 1 >= size )
+		    out = var_grow( out, &size, len + 1 );
 
-		*out++ = *in++;
+		out[ len++ ] = *in++;
 	    }
 
-	    lastword = out;
+	    lastword = len;
 
 	    /* Copy non-white space, watching for variables */
 
 	    while( *in && !isspace( *in ) )
 	    {
-	        if( out >= oute )
-		    return -1;
+		if( len + 1 >= size )
+		    out = var_grow( out, &size, len + 1 );
 
 		if( in[0] == '$' && in[1] == '(' )
 		    dollar++;
 
-		*out++ = *in++;
+		out[ len++ ] = *in++;
 	    }
 
 	    /* If a variable encountered, expand it and and embed the */
 	    /* space-separated members of the list in the output. */
+	    /* The word is null terminated so var_expand() can't read */
+	    /* stale bytes past its end. */
 
 	    if( dollar )
 	    {
-		LIST	*l;
+		LIST	*l, *l0;
+
+		out[ len ] = '\0';
 
-		l = var_expand( L0, lastword, out, lol, 0 );
+		l0 = var_expand( L0, out + lastword, out + len, lol, 0 );
 
-		out = lastword;
+		len = lastword;
 
-		for( ; l; l = list_next( l ) )
+		for( l = l0; l; l = list_next( l ) )
 		{
 		    int so = strlen( l->string );
 
-		    if( out + so >= oute )
-			return -1;
+		    if( len + so + 1 >= size )
+			out = var_grow( out, &size, len + so + 1 );
 
-		    strcpy( out, l->string );
-		    out += so;
-		    *out++ = ' ';
+		    memcpy( out + len, l->string, so );
+		    len += so;
+		    out[ len++ ] = ' ';
 		}
 
-		list_free( l );
+		list_free( l0 );
 	    }
 	}
 
-	if( out >= oute )
-	    return -1;
+	out = (char *)realloc( out, len + 1 );
+	out[ len ] = '\0';
+
+	if( lenp )
+	    *lenp = len;
+
+	return out;
+}
 
-	*out++ = '\0';
+/*
+ * var_grow() - make room in a var_string() buffer for at least need bytes
+ */
+
+static char *
+var_grow( out, size, need )
+char	*out;
+int	*size;
+int	need;
+{
+	while( *size <= need )
+	    *size *= 2;
 
-	return out - out0;
+	return (char *)realloc( out, *size );
 }
 
 /*
@@ -15,7 +15,7 @@ void var_defines();
 void var_set();
 LIST *var_swap();
 LIST *var_list();
-int var_string();
+char *var_string();
 void var_done();
 
 /*